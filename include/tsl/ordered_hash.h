@@ -545,6 +545,37 @@ class ordered_hash : private Hash, private KeyEqual {
     other.m_grow_on_next_insert = false;
   }
 
+  ordered_hash(const ordered_hash& other, const Allocator& alloc)
+      : Hash(other),
+        KeyEqual(other),
+        m_buckets_data(other.m_buckets_data, alloc),
+        m_buckets(m_buckets_data.empty() ? static_empty_bucket_ptr()
+                                         : m_buckets_data.data()),
+        m_hash_mask(other.m_hash_mask),
+        m_values(other.m_values, alloc),
+        m_load_threshold(other.m_load_threshold),
+        m_max_load_factor(other.m_max_load_factor),
+        m_grow_on_next_insert(other.m_grow_on_next_insert) {}
+
+  ordered_hash(ordered_hash&& other, const Allocator& alloc)
+      : Hash(std::move(static_cast<Hash&>(other))),
+        KeyEqual(std::move(static_cast<KeyEqual&>(other))),
+        m_buckets_data(std::move(other.m_buckets_data), alloc),
+        m_buckets(m_buckets_data.empty() ? static_empty_bucket_ptr()
+                                         : m_buckets_data.data()),
+        m_hash_mask(other.m_hash_mask),
+        m_values(std::move(other.m_values), alloc),
+        m_load_threshold(other.m_load_threshold),
+        m_max_load_factor(other.m_max_load_factor),
+        m_grow_on_next_insert(other.m_grow_on_next_insert) {
+    other.m_buckets_data.clear();
+    other.m_buckets = static_empty_bucket_ptr();
+    other.m_hash_mask = 0;
+    other.m_values.clear();
+    other.m_load_threshold = 0;
+    other.m_grow_on_next_insert = false;
+  }
+
   ordered_hash& operator=(const ordered_hash& other) {
     if (&other != this) {
       Hash::operator=(other);
@@ -1193,7 +1224,8 @@ class ordered_hash : private Hash, private KeyEqual {
       return;
     }
 
-    buckets_container_type old_buckets(bucket_count);
+    buckets_container_type old_buckets(bucket_count,
+                                       m_buckets_data.get_allocator());
     m_buckets_data.swap(old_buckets);
     m_buckets = m_buckets_data.empty() ? static_empty_bucket_ptr()
                                        : m_buckets_data.data();
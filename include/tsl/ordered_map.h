@@ -155,6 +155,12 @@ class ordered_map {
   explicit ordered_map(const Allocator& alloc)
       : ordered_map(ht::DEFAULT_INIT_BUCKETS_SIZE, alloc) {}
 
+  ordered_map(const ordered_map& other, const Allocator& alloc)
+      : m_ht(other.m_ht, alloc) {}
+
+  ordered_map(ordered_map&& other, const Allocator& alloc)
+      : m_ht(std::move(other.m_ht), alloc) {}
+
   template <class InputIt>
   ordered_map(InputIt first, InputIt last,
               size_type bucket_count = ht::DEFAULT_INIT_BUCKETS_SIZE,
@@ -134,6 +134,12 @@ class ordered_set {
   explicit ordered_set(const Allocator& alloc)
       : ordered_set(ht::DEFAULT_INIT_BUCKETS_SIZE, alloc) {}
 
+  ordered_set(const ordered_set& other, const Allocator& alloc)
+      : m_ht(other.m_ht, alloc) {}
+
+  ordered_set(ordered_set&& other, const Allocator& alloc)
+      : m_ht(std::move(other.m_ht), alloc) {}
+
   template <class InputIt>
   ordered_set(InputIt first, InputIt last,
               size_type bucket_count = ht::DEFAULT_INIT_BUCKETS_SIZE,
@@ -2,188 +2,975 @@
 
 #include "yavl-cpp/runtime.h"
 
-template<typename T>
-inline void operator>>(const YAML::Node &node, T &obj) {
-  obj = node.as<T>();
-}
+namespace YAVL {
 
 template<typename T>
-inline void operator>>(const YAML::Node &node, std::vector<T> &obj) {
-  for (const auto &it : node) {
-    T tmp;
-    (YAML::Node) it >> tmp;
-    obj.push_back(tmp);
+struct decoder {
+  static Status decode(const YAML::Node &node, T &obj) {
+#ifdef __cpp_exceptions
+    try {
+#endif
+      if (YAML::convert<T>::decode(node, obj)) {
+        return Status();
+      }
+#ifdef __cpp_exceptions
+    } catch (const YAML::Exception &) {
+      // Conversions of third-party types may use the throwing yaml-cpp API internally.
+    }
+#endif
+    return Status::bad_conversion(node.Mark());
+  }
+};
+
+template<typename Traits, typename Allocator>
+struct decoder<std::basic_string<char, Traits, Allocator>> {
+  static Status decode(const YAML::Node &node, std::basic_string<char, Traits, Allocator> &obj) {
+    if (node.IsScalar()) {
+      obj.assign(node.Scalar());
+    } else if (node.IsNull()) {
+      obj = "null";
+    } else {
+      return Status::bad_conversion(node.Mark());
+    }
+    return Status();
+  }
+};
+
+/**
+ * Parses an integer the way YAML writes them: an optional sign, followed by decimal digits, or
+ * by `0x` and hexadecimal digits, or by `0o` or a leading `0` and octal digits. Fails if the
+ * value does not fit into `T`.
+ */
+template<std::integral T>
+inline bool parse_number(std::string_view text, T &obj) {
+  bool negative = false;
+  if (!text.empty() && (text.front() == '+' || text.front() == '-')) {
+    negative = text.front() == '-';
+    text.remove_prefix(1);
+  }
+  int base = 10;
+  if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+    base = 16;
+    text.remove_prefix(2);
+  } else if (text.size() > 2 && text[0] == '0' && text[1] == 'o') {
+    base = 8;
+    text.remove_prefix(2);
+  } else if (text.size() > 1 && text[0] == '0') {
+    base = 8;
+    text.remove_prefix(1);
+  }
+  // The magnitude is parsed unsigned, so that a second sign is rejected.
+  using U = std::make_unsigned_t<T>;
+  U magnitude;
+  const char *end = text.data() + text.size();
+  if (const auto result = std::from_chars(text.data(), end, magnitude, base); result.ec != std::errc() || result.ptr != end) {
+    return false;
+  }
+  if (!negative) {
+    if (magnitude > static_cast<U>(std::numeric_limits<T>::max())) {
+      return false;
+    }
+    obj = static_cast<T>(magnitude);
+    return true;
+  }
+  if constexpr (std::is_unsigned_v<T>) {
+    return false;
+  } else {
+    // The magnitude of the minimum is one more than the maximum.
+    if (magnitude > static_cast<U>(std::numeric_limits<T>::max()) + 1) {
+      return false;
+    }
+    obj = static_cast<T>(U(0) - magnitude);
+    return true;
   }
 }
 
-template<typename T, std::size_t N>
-inline void operator>>(const YAML::Node &node, std::array<T, N> &obj) {
-  std::vector<T> vec;
-  node >> vec;
-  if (vec.size() != N) {
-    throw YAVL::InvalidSequenceLengthException(N, vec.size());
+/**
+ * Parses a floating point number with an optional sign, or one of YAML's `.inf`, `-.inf` and `.nan`
+ * in any of the spellings yaml-cpp accepts. Fails if the value is out of the range of `T`.
+ */
+template<std::floating_point T>
+inline bool parse_number(std::string_view text, T &obj) {
+  if (text == ".nan" || text == ".NaN" || text == ".NAN") {
+    obj = std::numeric_limits<T>::quiet_NaN();
+    return true;
+  }
+  bool negative = false;
+  if (!text.empty() && (text.front() == '+' || text.front() == '-')) {
+    negative = text.front() == '-';
+    text.remove_prefix(1);
   }
-  std::copy(vec.begin(), vec.end(), obj.begin());
+  if (text == ".inf" || text == ".Inf" || text == ".INF") {
+    obj = negative ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+    return true;
+  }
+  // std::from_chars also accepts "inf" and "nan", which are plain strings in YAML.
+  if (text.empty() || !(text.front() == '.' || (text.front() >= '0' && text.front() <= '9'))) {
+    return false;
+  }
+  T magnitude;
+  const char *end = text.data() + text.size();
+  if (const auto result = std::from_chars(text.data(), end, magnitude); result.ec != std::errc() || result.ptr != end) {
+    return false;
+  }
+  obj = negative ? -magnitude : magnitude;
+  return true;
 }
 
+template<number_type T>
+struct decoder<T> {
+  static Status decode(const YAML::Node &node, T &obj) {
+    if (!node.IsScalar() || !parse_number(std::string_view(node.Scalar()), obj)) {
+      return Status::bad_conversion(node.Mark());
+    }
+    return Status();
+  }
+};
+
+template<typename T, typename Allocator>
+struct decoder<std::vector<T, Allocator>> {
+  static Status decode(const YAML::Node &node, std::vector<T, Allocator> &obj) {
+    // Items are decoded into the elements that are already there and surplus elements are erased,
+    // so that decoding into the same vector again reuses its memory and that of its elements.
+    if (!node.IsSequence() && !node.IsNull()) {
+      return Status::bad_conversion(node.Mark());
+    }
+    obj.reserve(node.size());
+    std::size_t count = 0;
+    for (const auto &it : node) {
+      if constexpr (std::is_same_v<T, bool>) {
+        // std::vector<bool> has no addressable elements to decode into.
+        bool tmp;
+        if (Status status = YAVL::decode(it, tmp); !status) {
+          return status;
+        }
+        if (count < obj.size()) {
+          obj[count] = tmp;
+        } else {
+          obj.push_back(tmp);
+        }
+      } else {
+        T &element = count < obj.size() ? obj[count] : obj.emplace_back();
+        if (Status status = YAVL::decode(it, element); !status) {
+          return status;
+        }
+      }
+      ++count;
+    }
+    obj.erase(obj.begin() + count, obj.end());
+    return Status();
+  }
+};
+
+/**
+ * Decodes a sequence of exactly `N` items in place into the elements starting at `obj`.
+ */
 template<typename T, std::size_t N>
-inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::array<T, N> &input) {
-  std::vector<T> vec;
-  std::copy(input.begin(), input.end(), std::back_inserter(vec));
-  return output << vec;
+inline Status decode_fixed_sequence(const YAML::Node &node, T *obj) {
+  if (!node.IsSequence() && !node.IsNull()) {
+    return Status::bad_conversion(node.Mark());
+  }
+  if (node.size() != N) {
+    return Status::invalid_sequence_length(N, node.size(), node.Mark());
+  }
+  std::size_t i = 0;
+  for (const auto &it : node) {
+    if (Status status = YAVL::decode(it, obj[i++]); !status) {
+      return status;
+    }
+  }
+  return Status();
 }
 
 template<typename T, std::size_t N>
-inline YAML::Emitter &operator<<(YAML::Emitter &output, const T (&input)[N]) {
-  std::vector<T> vec;
-  std::copy(std::begin(input), std::end(input), std::back_inserter(vec));
-  return output << vec;
-}
+struct decoder<std::array<T, N>> {
+  static Status decode(const YAML::Node &node, std::array<T, N> &obj) {
+    return decode_fixed_sequence<T, N>(node, obj.data());
+  }
+};
 
 template<typename T, std::size_t N>
-inline void operator>>(const YAML::Node &node, T (&obj)[N]) {
-  std::array<T, N> stdarr;
-  node >> stdarr;
-  std::copy(stdarr.begin(), stdarr.end(), std::begin(obj));
+struct decoder<T[N]> {
+  static Status decode(const YAML::Node &node, T (&obj)[N]) {
+    return decode_fixed_sequence<T, N>(node, obj);
+  }
+};
+
+/**
+ * Returns a new item for `container`, which uses the allocator of the container if `T` takes one.
+ */
+template<typename T, typename Container>
+inline T make_item(const Container &container) {
+  return std::make_obj_using_allocator<T>(container.get_allocator());
 }
 
+/**
+ * Returns whether `node` decodes to `item`, which an ordered container holds at the position of
+ * `node`. Otherwise, `node` has been decoded into `scratch` with the result `status`, so that it
+ * doesn't have to be decoded again to replace `item`. Strings are compared to the scalar directly and
+ * are only decoded if they differ.
+ */
 template<typename T>
-inline void operator>>(const YAML::Node &node, tsl::ordered_set<T> &obj) {
-  std::vector<T> vec;
-  node >> vec;
-  std::copy(vec.begin(), vec.end(), std::inserter(obj, obj.begin()));
-  if (obj.size() != vec.size()) {
-    throw YAVL::DuplicateSetItemException();
+inline bool decodes_to(const YAML::Node &node, const T &item, T &scratch, Status &status) {
+  if constexpr (requires { item.compare(node.Scalar()); }) {
+    if (node.IsScalar() ? item.compare(node.Scalar()) == 0 : node.IsNull() && item.compare("null") == 0) {
+      return true;
+    }
+    status = YAVL::decode(node, scratch);
+    return false;
+  } else {
+    status = YAVL::decode(node, scratch);
+    return status.ok() && scratch == item;
   }
 }
 
-template<typename T>
-inline YAML::Emitter &operator<<(YAML::Emitter &output, const tsl::ordered_set<T> &input) {
-  std::vector<T> vec;
-  std::copy(input.begin(), input.end(), std::back_inserter(vec));
-  return output << vec;
+/**
+ * Takes all nodes out of a node-based container (e.g. `std::map`) that is about to be decoded into
+ * again, so that the new items can be decoded into the nodes of the previous ones, together with
+ * the memory of the strings and containers inside them, instead of allocating new nodes. A node is
+ * matched to the item with the same key if there is one, so that its value is decoded into a value
+ * of the same shape. The remaining nodes are handed out to the items without a match. The handles
+ * of up to 64 nodes are kept on the stack.
+ *
+ * Every key is decoded only once: the key of a matched node is already in place, and the keys of the
+ * other items are kept from matching until `decode_key` moves them into their node.
+ */
+template<typename Container>
+class NodeRecycler {
+  public:
+    using node_type = typename Container::node_type;
+    using key_type = typename Container::key_type;
+
+    // `keys` returns the key node of an item of the mapping or sequence `node`.
+    template<typename Keys>
+    NodeRecycler(Container &obj, const YAML::Node &node, Keys &&keys) : items(&arena), spares(&arena) {
+      if (obj.empty()) {
+        return;
+      }
+      items.reserve(node.size());
+      auto key = make_item<key_type>(obj);
+      for (const auto &it : node) {
+        Item &item = items.emplace_back();
+        if constexpr (std::is_same_v<key_type, std::string>) {
+          // Looks up the scalar without decoding it to `key` first.
+          if (keys(it).IsScalar()) {
+            if (const auto match = obj.find(keys(it).Scalar()); match != obj.end()) {
+              item.node = obj.extract(match);
+            }
+            continue;
+          }
+        }
+        if (!YAVL::decode(keys(it), key).ok()) {
+          // Decoded again by `decode_key`, which reports the error.
+          continue;
+        }
+        if (const auto match = obj.find(key); match != obj.end()) {
+          item.node = obj.extract(match);
+        } else {
+          item.key.emplace(std::move(key));
+          key = make_item<key_type>(obj);
+        }
+      }
+      take_spares(obj);
+    }
+
+    // Takes the nodes out of `obj` without matching them, for items whose keys are only known once
+    // they are decoded.
+    explicit NodeRecycler(Container &obj) : items(&arena), spares(&arena) {
+      take_spares(obj);
+    }
+
+    NodeRecycler(const NodeRecycler &) = delete;
+    NodeRecycler &operator=(const NodeRecycler &) = delete;
+
+    // Returns the node for the item `index`, which is empty if there is none left. Its key has to be
+    // set with `decode_key`.
+    node_type take(std::size_t index) {
+      if (index < items.size() && !items[index].node.empty()) {
+        items[index].matched = true;
+        return std::move(items[index].node);
+      }
+      if (next < spares.size()) {
+        return std::move(spares[next++].node);
+      }
+      return node_type();
+    }
+
+    // Sets `key` to the key of the item `index`, which is decoded from `node` unless that already
+    // happened while matching.
+    Status decode_key(std::size_t index, const YAML::Node &node, key_type &key) {
+      if (index < items.size()) {
+        if (items[index].matched) {
+          return Status();
+        }
+        if (items[index].key) {
+          key = std::move(*items[index].key);
+          return Status();
+        }
+      }
+      return YAVL::decode(node, key);
+    }
+
+  private:
+    void take_spares(Container &obj) {
+      spares.reserve(obj.size());
+      while (!obj.empty()) {
+        spares.push_back({obj.extract(obj.begin())});
+      }
+    }
+
+    // Wrapped, so that the handles and keys aren't constructed with the allocator of the vectors.
+    struct Item {
+        node_type node;
+        std::optional<key_type> key;
+        bool matched = false;
+    };
+
+    struct Spare {
+        node_type node;
+    };
+
+    alignas(Item) std::array<std::byte, 64 * sizeof(Item)> buffer;
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+    std::pmr::vector<Item> items;
+    std::pmr::vector<Spare> spares;
+    std::size_t next = 0;
+};
+
+/**
+ * Decodes the items of a sequence straight into a set, reporting the first item that is already
+ * contained in it. The previous items of the set are recycled with `NodeRecycler`.
+ */
+template<typename Set>
+inline Status decode_set(const YAML::Node &node, Set &obj) {
+  if (!node.IsSequence() && !node.IsNull()) {
+    return Status::bad_conversion(node.Mark());
+  }
+  NodeRecycler<Set> recycler(obj, node, [](const YAML::Node &item) -> const YAML::Node & { return item; });
+  if constexpr (requires { obj.reserve(node.size()); }) {
+    obj.reserve(node.size());
+  }
+  std::size_t index = 0;
+  for (const auto &it : node) {
+    if (auto slot = recycler.take(index)) {
+      if (Status status = recycler.decode_key(index++, it, slot.value()); !status) {
+        return status;
+      }
+      if (!obj.insert(std::move(slot)).inserted) {
+        return Status::duplicate_set_item(it.Mark());
+      }
+      continue;
+    }
+    auto element = make_item<typename Set::value_type>(obj);
+    if (Status status = recycler.decode_key(index++, it, element); !status) {
+      return status;
+    }
+    if (!obj.insert(std::move(element)).second) {
+      return Status::duplicate_set_item(it.Mark());
+    }
+  }
+  return Status();
 }
 
-template<typename T>
-inline void operator>>(const YAML::Node &node, std::set<T> &obj) {
-  tsl::ordered_set<T> tmp;
-  node >> tmp;
-  std::copy(tmp.begin(), tmp.end(), std::inserter(obj, obj.begin()));
+/**
+ * Decodes the items of a sequence straight into an ordered set. Items that match the previous
+ * contents of the set at the same position are kept, the remaining ones are replaced.
+ */
+template<typename Set>
+inline Status decode_ordered_set(const YAML::Node &node, Set &obj) {
+  if (!node.IsSequence() && !node.IsNull()) {
+    return Status::bad_conversion(node.Mark());
+  }
+  obj.reserve(node.size());
+  std::size_t count = 0;
+  auto element = make_item<typename Set::value_type>(obj);
+  for (const auto &it : node) {
+    Status status;
+    if (count < obj.size()) {
+      const auto slot = obj.nth(count);
+      if (decodes_to(it, *slot, element, status)) {
+        ++count;
+        continue;
+      }
+      obj.erase(slot, obj.end());
+    } else {
+      status = YAVL::decode(it, element);
+    }
+    if (!status) {
+      return status;
+    }
+    if (!obj.insert(std::move(element)).second) {
+      return Status::duplicate_set_item(it.Mark());
+    }
+    element = make_item<typename Set::value_type>(obj);
+    ++count;
+  }
+  obj.erase(obj.nth(count), obj.end());
+  return Status();
 }
 
-template<typename T>
-inline void operator>>(const YAML::Node &node, std::unordered_set<T> &obj) {
-  tsl::ordered_set<T> tmp;
-  node >> tmp;
-  std::copy(tmp.begin(), tmp.end(), std::inserter(obj, obj.begin()));
+/**
+ * Decodes the value of a map item in place after its key has been inserted.
+ */
+template<typename Iterator>
+inline Status decode_map_value(const YAML::Node &node, Iterator slot) {
+  if constexpr (requires { slot.value(); }) {
+    return YAVL::decode(node, slot.value());
+  } else {
+    return YAVL::decode(node, slot->second);
+  }
 }
 
-template<typename T>
-inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::unordered_set<T> &input) {
-  std::vector<T> vec;
-  std::copy(input.begin(), input.end(), std::back_inserter(vec));
-  return output << vec;
+/**
+ * Decodes the items of a mapping straight into a map. Values are decoded in place after their key
+ * has been inserted, and the first key that is already contained in the map is reported. The
+ * previous items of the map are recycled with `NodeRecycler`.
+ */
+template<typename Map>
+inline Status decode_map(const YAML::Node &node, Map &obj) {
+  if (!node.IsMap() && !node.IsNull()) {
+    return Status::bad_conversion(node.Mark());
+  }
+  NodeRecycler<Map> recycler(obj, node, [](const auto &item) -> const YAML::Node & { return item.first; });
+  if constexpr (requires { obj.reserve(node.size()); }) {
+    obj.reserve(node.size());
+  }
+  std::size_t index = 0;
+  for (const auto &it : node) {
+    if (auto slot = recycler.take(index)) {
+      if (Status status = recycler.decode_key(index++, it.first, slot.key()); !status) {
+        return status;
+      }
+      if (obj.contains(slot.key())) {
+        return Status::duplicate_map_item(it.first.Mark());
+      }
+      if (Status status = YAVL::decode(it.second, slot.mapped()); !status) {
+        return status;
+      }
+      obj.insert(std::move(slot));
+      continue;
+    }
+    auto key = make_item<typename Map::key_type>(obj);
+    if (Status status = recycler.decode_key(index++, it.first, key); !status) {
+      return status;
+    }
+    auto [slot, inserted] = obj.try_emplace(std::move(key));
+    if (!inserted) {
+      return Status::duplicate_map_item(it.first.Mark());
+    }
+    if (Status status = decode_map_value(it.second, slot); !status) {
+      return status;
+    }
+  }
+  return Status();
 }
 
-template<typename KT, typename VT>
-inline void operator>>(const YAML::Node &node, tsl::ordered_map<KT, VT> &obj) {
+/**
+ * Decodes the items of a mapping straight into an ordered map. The values of items whose key
+ * matches the previous contents of the map at the same position are decoded in place, the
+ * remaining items are replaced.
+ */
+template<typename Map>
+inline Status decode_ordered_map(const YAML::Node &node, Map &obj) {
+  if (!node.IsMap() && !node.IsNull()) {
+    return Status::bad_conversion(node.Mark());
+  }
+  obj.reserve(node.size());
+  std::size_t count = 0;
+  auto key = make_item<typename Map::key_type>(obj);
+  for (const auto &it : node) {
+    Status status;
+    if (count < obj.size()) {
+      const auto slot = obj.nth(count);
+      // The keys before this one are distinct from it, so it can't be a duplicate.
+      if (decodes_to(it.first, slot->first, key, status)) {
+        if (status = decode_map_value(it.second, slot); !status) {
+          return status;
+        }
+        ++count;
+        continue;
+      }
+      obj.erase(slot, obj.end());
+    } else {
+      status = YAVL::decode(it.first, key);
+    }
+    if (!status) {
+      return status;
+    }
+    auto [slot, inserted] = obj.try_emplace(std::move(key));
+    if (!inserted) {
+      return Status::duplicate_map_item(it.first.Mark());
+    }
+    key = make_item<typename Map::key_type>(obj);
+    if (status = decode_map_value(it.second, slot); !status) {
+      return status;
+    }
+    ++count;
+  }
+  obj.erase(obj.nth(count), obj.end());
+  return Status();
+}
+
+template<typename T, typename... Rest>
+struct decoder<tsl::ordered_set<T, Rest...>> {
+  static Status decode(const YAML::Node &node, tsl::ordered_set<T, Rest...> &obj) {
+    return decode_ordered_set(node, obj);
+  }
+};
+
+template<typename T, typename Compare, typename Allocator>
+struct decoder<std::set<T, Compare, Allocator>> {
+  static Status decode(const YAML::Node &node, std::set<T, Compare, Allocator> &obj) {
+    return decode_set(node, obj);
+  }
+};
+
+template<typename T, typename Hash, typename KeyEqual, typename Allocator>
+struct decoder<std::unordered_set<T, Hash, KeyEqual, Allocator>> {
+  static Status decode(const YAML::Node &node, std::unordered_set<T, Hash, KeyEqual, Allocator> &obj) {
+    return decode_set(node, obj);
+  }
+};
+
+template<typename KT, typename VT, typename... Rest>
+struct decoder<tsl::ordered_map<KT, VT, Rest...>> {
+  static Status decode(const YAML::Node &node, tsl::ordered_map<KT, VT, Rest...> &obj) {
+    return decode_ordered_map(node, obj);
+  }
+};
+
+template<typename KT, typename VT, typename Compare, typename Allocator>
+struct decoder<std::map<KT, VT, Compare, Allocator>> {
+  static Status decode(const YAML::Node &node, std::map<KT, VT, Compare, Allocator> &obj) {
+    return decode_map(node, obj);
+  }
+};
+
+template<typename KT, typename VT, typename Hash, typename KeyEqual, typename Allocator>
+struct decoder<std::unordered_map<KT, VT, Hash, KeyEqual, Allocator>> {
+  static Status decode(const YAML::Node &node, std::unordered_map<KT, VT, Hash, KeyEqual, Allocator> &obj) {
+    return decode_map(node, obj);
+  }
+};
+
+template<typename Tuple, std::size_t... I>
+inline Status decode_tuple_items(YAML::const_iterator it, Tuple &obj, std::index_sequence<I...>) {
+  Status status;
+  // Stops at the first item that fails to decode.
+  static_cast<void>(((status = YAVL::decode(*it++, std::get<I>(obj))).ok() && ...));
+  return status;
+}
+
+template<class... Types>
+struct decoder<std::tuple<Types...>> {
+  static Status decode(const YAML::Node &node, std::tuple<Types...> &obj) {
+    // A null is an empty sequence like for the other sequences, and so is too short.
+    if (!node.IsSequence() && !node.IsNull()) {
+      return Status::bad_conversion(node.Mark());
+    }
+    if (node.size() != sizeof...(Types)) {
+      return Status::invalid_sequence_length(sizeof...(Types), node.size(), node.Mark());
+    }
+    return decode_tuple_items(node.begin(), obj, std::index_sequence_for<Types...>());
+  }
+};
+
+template<typename T>
+struct decoder<std::optional<T>> {
+  static Status decode(const YAML::Node &node, std::optional<T> &obj) {
+    if (node.IsDefined() && !node.IsNull()) {
+      return YAVL::decode(node, ensure_value(obj));
+    }
+    obj = std::nullopt;
+    return Status();
+  }
+};
+
+/**
+ * Makes `lazy<T>` allocator-aware if `T` is, so that it is constructed with the allocator of the map
+ * type that contains it in `--pmr` mode.
+ */
+template<typename T>
+struct lazy_allocator {};
+
+template<pmr_type T>
+struct lazy_allocator<T> {
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+};
+
+/**
+ * A value that keeps its YAML node and is only decoded to `T` when it is first accessed, so that
+ * large sections of a document that are rarely read don't have to be converted up front. Use it
+ * in a spec like any other type, e.g. `YAVL::lazy<RegionOverrides>`. The decoded value is memoized,
+ * and accessing it from several threads at once is safe. Errors in the node are reported by
+ * `load()` on first access, or right away by `validate`. A moved-from `lazy` may only be assigned
+ * to or destroyed.
+ *
+ * Decoding into a `lazy` again keeps its previous value, which the next node is decoded into on
+ * first access. If `T` takes an allocator, the value is constructed with the allocator of the
+ * `lazy`, which is also used for the values without a container to take it from.
+ */
+template<typename T>
+class lazy : public lazy_allocator<T> {
+  public:
+    lazy() : lazy(T()) {}
+
+    lazy(T value) : state(std::make_unique<State>(nullptr, std::move(value))) {
+      state->loaded = true;
+    }
+
+    explicit lazy(YAML::Node node) : state(std::make_unique<State>(nullptr)) {
+      state->node = std::move(node);
+    }
+
+    explicit lazy(const std::pmr::polymorphic_allocator<> &allocator)
+      requires pmr_type<T>
+        : state(std::make_unique<State>(allocator.resource(), std::make_obj_using_allocator<T>(allocator))) {
+      state->loaded = true;
+    }
+
+    lazy(const lazy &other) : state(std::make_unique<State>(nullptr)) {
+      assign(other);
+    }
+
+    lazy(const lazy &other, const std::pmr::polymorphic_allocator<> &allocator)
+      requires pmr_type<T>
+        : lazy(allocator) {
+      assign(other);
+    }
+
+    lazy(lazy &&) = default;
+
+    lazy(lazy &&other, const std::pmr::polymorphic_allocator<> &allocator)
+      requires pmr_type<T>
+        : lazy(allocator) {
+      assign(std::move(other));
+    }
+
+    lazy &operator=(const lazy &other) {
+      if (this != &other) {
+        assign(other);
+      }
+      return *this;
+    }
+
+    lazy &operator=(lazy &&) = default;
+
+    /**
+     * Decodes the node if that hasn't happened yet and returns the result of decoding it.
+     */
+    const Status &load() const {
+      if (!is_loaded()) {
+        const std::lock_guard lock(state->mutex);
+        if (!state->loaded.load(std::memory_order_relaxed)) {
+          const ResourceScope scope(state->resource ? state->resource : decode_resource);
+          state->status = YAVL::decode(state->node, state->value);
+          state->loaded.store(true, std::memory_order_release);
+        }
+      }
+      return state->status;
+    }
+
+    bool is_loaded() const {
+      return state->loaded.load(std::memory_order_acquire);
+    }
+
+    /**
+     * The node the value is decoded from. It is undefined if the value was not decoded from a node.
+     */
+    const YAML::Node &node() const {
+      return state->node;
+    }
+
+    /**
+     * Returns the decoded value. Fails like `Status::throw_on_error()` if the node can't be decoded.
+     */
+    const T &get() const {
+      load().throw_on_error();
+      return state->value;
+    }
+
+    T &get() {
+      load().throw_on_error();
+      return state->value;
+    }
+
+    const T &operator*() const {
+      return get();
+    }
+
+    T &operator*() {
+      return get();
+    }
+
+    const T *operator->() const {
+      return &get();
+    }
+
+    T *operator->() {
+      return &get();
+    }
+
+  private:
+    struct State {
+      template<typename... Args>
+      explicit State(std::pmr::memory_resource *resource, Args &&...args)
+          : value(std::forward<Args>(args)...), resource(resource) {}
+
+      YAML::Node node;
+      std::mutex mutex;
+      std::atomic<bool> loaded = false;
+      T value;
+      Status status;
+      // The resource of `value` if it was constructed with an allocator, or null.
+      std::pmr::memory_resource *resource;
+    };
+
+    // Takes the node and, if it has been decoded, the value of `other`, keeping the allocator of
+    // the value.
+    template<typename Other>
+    void assign(Other &&other) {
+      state->node = other.state->node;
+      state->status = other.state->status;
+      if (other.is_loaded()) {
+        state->value = std::forward<Other>(other).state->value;
+      }
+      state->loaded.store(other.is_loaded(), std::memory_order_relaxed);
+    }
+
+    // Starts over with `node`, which is decoded into the previous value on first access.
+    void reset(YAML::Node node) {
+      if (!state) {
+        state = std::make_unique<State>(nullptr);
+      }
+      state->node = std::move(node);
+      state->status = Status();
+      state->loaded.store(false, std::memory_order_relaxed);
+    }
+
+    template<typename U>
+    friend struct decoder;
+
+    template<typename U>
+    friend struct binary_codec;
+
+    template<typename U>
+    friend struct event_reader;
+
+    std::unique_ptr<State> state;
+};
+
+template<typename T>
+struct decoder<lazy<T>> {
+  static Status decode(const YAML::Node &node, lazy<T> &obj) {
+    obj.reset(node);
+    if (decode_eagerly) {
+      return obj.load();
+    }
+    return Status();
+  }
+};
+
+/**
+ * Decodes only the `fields` of the map type `T` from `node` and leaves the other fields of `obj`
+ * untouched, so that their subtrees don't have to be decoded. Requested fields are decoded
+ * completely. The keys of the map are checked as usual, except that skipped fields may be missing
+ * if `skipped` is `SkippedFields::skip`:
+ *
+ *     using fields = YAVL::fields<TopType>;
+ *     YAVL::Status status = YAVL::decode(node, top, fields::my_int | fields::my_vec);
+ */
+template<map_type T>
+inline Status decode(const YAML::Node &node, T &obj, const FieldMask<T> &fields,
+    SkippedFields skipped = SkippedFields::skip) {
+  using traits = map_traits<T>;
+  if (!node.IsMap() && !node.IsNull()) {
+    return Status::bad_conversion(node, traits::info);
+  }
+  std::bitset<traits::keys.size()> found;
+  std::optional<YAML::Node> superfluous_key;
   for (const auto &it : node) {
-    KT key;
-    VT val;
-    it.first >> key;
-    it.second >> val;
-    obj[key] = val;
+    if (!it.first.IsScalar()) {
+      return Status::bad_conversion(it.first.Mark());
+    }
+    const std::size_t index = key_index<T>(it.first.Scalar());
+    if (index == npos) {
+      if (!superfluous_key) {
+        superfluous_key = it.first;
+      }
+      continue;
+    }
+    if (found.test(index)) {
+      return Status::duplicate_map_item(it.first.Mark());
+    }
+    found.set(index);
+    Status status;
+    if (fields.test(index)) {
+      traits::visit(obj, index, [&](auto &field) { status = YAVL::decode(it.second, field); });
+    } else if (skipped == SkippedFields::validate) {
+      traits::visit_type(index, [&](auto type) {
+        typename decltype(type)::type tmp{};
+        status = YAVL::decode(it.second, tmp);
+      });
+    }
+    if (!status) {
+      return status;
+    }
+  }
+  for (std::size_t i = 0; i < traits::keys.size(); ++i) {
+    if (found.test(i) || (!fields.test(i) && skipped == SkippedFields::skip)) {
+      continue;
+    }
+    if (traits::required[i]) {
+      return Status::missing_key(traits::info, i, node.Mark());
+    }
+    if (fields.test(i)) {
+      traits::visit(obj, i, [](auto &field) {
+        if constexpr (is_optional<std::remove_reference_t<decltype(field)>>::value) {
+          field = std::nullopt;
+        }
+      });
+    }
   }
-  if (obj.size() != node.size()) {
-    throw YAVL::DuplicateMapItemException();
+  if (superfluous_key) {
+    return Status::superfluous_key(traits::info, superfluous_key->Scalar(), superfluous_key->Mark());
   }
+  return Status();
+}
+
+} // namespace YAVL
+
+template<typename T>
+inline void operator>>(const YAML::Node &node, T &obj) {
+  YAVL::decode(node, obj).throw_on_error();
 }
 
+// The writers are declared up front, since they are not found by argument-dependent lookup when
+// they are nested. yaml-cpp only knows containers with the default allocator.
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::string &input);
+
+template<typename T, std::size_t N>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::array<T, N> &input);
+
+template<typename T, std::size_t N>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const T (&input)[N]);
+
+template<typename T>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::vector<T> &input);
+
+template<typename T>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::set<T> &input);
+
 template<typename KT, typename VT>
-inline YAML::Emitter &operator<<(YAML::Emitter &output, const tsl::ordered_map<KT, VT> &input) {
-  output << YAML::BeginMap;
-  for (const auto &[key, value] : input) {
-    output << YAML::Key << key << YAML::Value << value;
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::map<KT, VT> &input);
+
+template<typename T, typename... Rest>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const tsl::ordered_set<T, Rest...> &input);
+
+template<typename T, typename Hash, typename KeyEqual, typename Allocator>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::unordered_set<T, Hash, KeyEqual, Allocator> &input);
+
+template<typename KT, typename VT, typename... Rest>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const tsl::ordered_map<KT, VT, Rest...> &input);
+
+template<typename KT, typename VT, typename Hash, typename KeyEqual, typename Allocator>
+inline YAML::Emitter &operator<<(
+    YAML::Emitter &output, const std::unordered_map<KT, VT, Hash, KeyEqual, Allocator> &input);
+
+template<class... Types>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::tuple<Types...> &input);
+
+template<typename T>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::optional<T> &input);
+
+template<typename T>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const YAVL::lazy<T> &input);
+
+namespace YAVL {
+
+// Writes the items of `input` as a sequence.
+template<typename Range>
+inline YAML::Emitter &write_sequence(YAML::Emitter &output, const Range &input) {
+  output << YAML::BeginSeq;
+  for (const auto &item : input) {
+    output << item;
   }
-  output << YAML::EndMap;
+  output << YAML::EndSeq;
   return output;
 }
 
-template<typename KT, typename VT>
-inline void operator>>(const YAML::Node &node, std::map<KT, VT> &obj) {
-  tsl::ordered_map<KT, VT> tmp;
-  node >> tmp;
-  std::copy(tmp.begin(), tmp.end(), std::inserter(obj, obj.end()));
+} // namespace YAVL
+
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::string &input) {
+  return output << std::string(input);
 }
 
-template<typename KT, typename VT>
-inline void operator>>(const YAML::Node &node, std::unordered_map<KT, VT> &obj) {
-  tsl::ordered_map<KT, VT> tmp;
-  node >> tmp;
-  std::copy(tmp.begin(), tmp.end(), std::inserter(obj, obj.end()));
+template<typename T>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::vector<T> &input) {
+  return YAVL::write_sequence(output, input);
+}
+
+template<typename T>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::set<T> &input) {
+  return YAVL::write_sequence(output, input);
 }
 
 template<typename KT, typename VT>
-inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::unordered_map<KT, VT> &input) {
-  tsl::ordered_map<KT, VT> tmp;
-  std::copy(input.begin(), input.end(), std::inserter(tmp, tmp.end()));
-  return output << tmp;
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::pmr::map<KT, VT> &input) {
+  output << YAML::BeginMap;
+  for (const auto &[key, value] : input) {
+    output << YAML::Key << key << YAML::Value << value;
+  }
+  output << YAML::EndMap;
+  return output;
+}
+
+template<typename T, std::size_t N>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::array<T, N> &input) {
+  return YAVL::write_sequence(output, input);
 }
 
-template<std::size_t I = 0, typename... Tp>
-inline typename std::enable_if<I == sizeof...(Tp), void>::type tuple_unpack(
-    std::tuple<Tp...> &t, std::vector<YAML::Node> vec) {
-  // Nothing
+template<typename T, std::size_t N>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const T (&input)[N]) {
+  return YAVL::write_sequence(output, input);
 }
 
-template<std::size_t I = 0, typename... Tp>
-    inline typename std::enable_if
-    < I<sizeof...(Tp), void>::type tuple_unpack(std::tuple<Tp...> &t, std::vector<YAML::Node> vec) {
-  using T = std::tuple_element_t<I, std::tuple<Tp...>>;
-  T tmp;
-  vec[0] >> tmp;
-  std::get<I>(t) = tmp;
-  vec.erase(vec.begin());
-  tuple_unpack<I + 1, Tp...>(t, vec);
+template<typename T, typename... Rest>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const tsl::ordered_set<T, Rest...> &input) {
+  return YAVL::write_sequence(output, input);
 }
 
-template<class... Types>
-inline void operator>>(const YAML::Node &node, std::tuple<Types...> &obj) {
-  const std::vector<YAML::Node> vec(node.begin(), node.end());
-  tuple_unpack(obj, vec);
+template<typename T, typename Hash, typename KeyEqual, typename Allocator>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::unordered_set<T, Hash, KeyEqual, Allocator> &input) {
+  return YAVL::write_sequence(output, input);
 }
 
-template<std::size_t I = 0, typename... Tp>
-inline typename std::enable_if<I == sizeof...(Tp), void>::type tuple_pack(std::tuple<Tp...> &t, YAML::Emitter &output) {
+template<typename KT, typename VT, typename... Rest>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const tsl::ordered_map<KT, VT, Rest...> &input) {
+  output << YAML::BeginMap;
+  for (const auto &[key, value] : input) {
+    output << YAML::Key << key << YAML::Value << value;
+  }
+  output << YAML::EndMap;
+  return output;
 }
 
-template<std::size_t I = 0, typename... Tp>
-    inline typename std::enable_if
-    < I<sizeof...(Tp), void>::type tuple_pack(std::tuple<Tp...> &t, YAML::Emitter &output) {
-  output << std::get<I>(t);
-  tuple_pack<I + 1, Tp...>(t, output);
+template<typename KT, typename VT, typename Hash, typename KeyEqual, typename Allocator>
+inline YAML::Emitter &operator<<(
+    YAML::Emitter &output, const std::unordered_map<KT, VT, Hash, KeyEqual, Allocator> &input) {
+  tsl::ordered_map<KT, VT> tmp;
+  std::copy(input.begin(), input.end(), std::inserter(tmp, tmp.end()));
+  return output << tmp;
 }
 
 template<class... Types>
 inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::tuple<Types...> &input) {
   output << YAML::BeginSeq;
-  std::tuple<Types...> tmp = input;
-  tuple_pack(tmp, output);
+  std::apply([&output](const auto &...items) { (output << ... << items); }, input);
   output << YAML::EndSeq;
   return output;
 }
 
-template<typename T>
-inline void operator>>(const YAML::Node &node, std::optional<T> &obj) {
-  if (node.IsDefined() && !node.IsNull()) {
-    T tmp;
-    node >> tmp;
-    obj = tmp;
-  } else {
-    obj = std::nullopt;
-  }
-}
-
 template<typename T>
 inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::optional<T> &input) {
   if (input.has_value()) {
@@ -192,3 +979,2154 @@ inline YAML::Emitter &operator<<(YAML::Emitter &output, const std::optional<T> &
   }
   return output;
 }
+
+// A value that was never decoded, or failed to decode, is written back as the original node.
+template<typename T>
+inline YAML::Emitter &operator<<(YAML::Emitter &output, const YAVL::lazy<T> &input) {
+  if (input.is_loaded() && input.load()) {
+    return output << *input;
+  }
+  return output << input.node();
+}
+
+namespace YAVL {
+
+/**
+ * The bytes a value is encoded to by `YAVL::encode`.
+ */
+using Buffer = std::vector<std::byte>;
+
+/**
+ * The bytes that are left to decode of a binary encoding.
+ */
+class BinaryInput {
+  public:
+    explicit BinaryInput(std::span<const std::byte> data) : data(data) {}
+
+    std::size_t remaining() const {
+      return data.size();
+    }
+
+    // Returns the next `size` bytes, which must not be more than `remaining()`.
+    std::span<const std::byte> take(std::size_t size) {
+      const std::span<const std::byte> bytes = data.first(size);
+      data = data.subspan(size);
+      return bytes;
+    }
+
+  private:
+    std::span<const std::byte> data;
+};
+
+inline Status truncated_binary() {
+  return Status::other("Unexpected end of binary data");
+}
+
+inline Status invalid_binary(std::string_view type_name) {
+  return Status::other(std::string("Invalid binary value for type ").append(type_name));
+}
+
+/**
+ * Arithmetic types, which are stored with their fixed width in little-endian byte order.
+ */
+template<typename T>
+concept binary_scalar_type = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+/**
+ * Types whose items can be copied to and from a binary encoding as a whole, since their
+ * representation in memory is the same.
+ */
+template<typename T>
+concept binary_memcpy_type = binary_scalar_type<T> && std::endian::native == std::endian::little;
+
+template<binary_scalar_type T>
+inline void write_little_endian(T value, Buffer &output) {
+  std::array<std::byte, sizeof(T)> bytes;
+  std::memcpy(bytes.data(), &value, sizeof(T));
+  if constexpr (std::endian::native == std::endian::big) {
+    std::reverse(bytes.begin(), bytes.end());
+  }
+  output.insert(output.end(), bytes.begin(), bytes.end());
+}
+
+template<binary_scalar_type T>
+inline Status read_little_endian(BinaryInput &input, T &value) {
+  if (input.remaining() < sizeof(T)) {
+    return truncated_binary();
+  }
+  std::array<std::byte, sizeof(T)> bytes;
+  const std::span<const std::byte> data = input.take(sizeof(T));
+  std::copy(data.begin(), data.end(), bytes.begin());
+  if constexpr (std::endian::native == std::endian::big) {
+    std::reverse(bytes.begin(), bytes.end());
+  }
+  std::memcpy(&value, bytes.data(), sizeof(T));
+  return Status();
+}
+
+// Writes the size of a string or container.
+inline void write_size(std::size_t size, Buffer &output) {
+  write_little_endian(static_cast<std::uint64_t>(size), output);
+}
+
+/**
+ * The fewest bytes that the binary encoding of a `T` takes, which bounds the number of items of type
+ * `T` that the remaining input can hold. Types that aren't listed here may take no bytes at all.
+ */
+template<typename T>
+inline constexpr std::size_t binary_min_size = 0;
+
+template<binary_scalar_type T>
+inline constexpr std::size_t binary_min_size<T> = sizeof(T);
+
+template<>
+inline constexpr std::size_t binary_min_size<bool> = 1;
+
+template<enum_type T>
+inline constexpr std::size_t binary_min_size<T> = sizeof(std::uint32_t);
+
+template<typename Traits, typename Allocator>
+inline constexpr std::size_t binary_min_size<std::basic_string<char, Traits, Allocator>> = sizeof(std::uint64_t);
+
+template<typename T, typename Allocator>
+inline constexpr std::size_t binary_min_size<std::vector<T, Allocator>> = sizeof(std::uint64_t);
+
+template<typename T, typename... Rest>
+inline constexpr std::size_t binary_min_size<std::set<T, Rest...>> = sizeof(std::uint64_t);
+
+template<typename T, typename... Rest>
+inline constexpr std::size_t binary_min_size<std::unordered_set<T, Rest...>> = sizeof(std::uint64_t);
+
+template<typename T, typename... Rest>
+inline constexpr std::size_t binary_min_size<tsl::ordered_set<T, Rest...>> = sizeof(std::uint64_t);
+
+template<typename KT, typename VT, typename... Rest>
+inline constexpr std::size_t binary_min_size<std::map<KT, VT, Rest...>> = sizeof(std::uint64_t);
+
+template<typename KT, typename VT, typename... Rest>
+inline constexpr std::size_t binary_min_size<std::unordered_map<KT, VT, Rest...>> = sizeof(std::uint64_t);
+
+template<typename KT, typename VT, typename... Rest>
+inline constexpr std::size_t binary_min_size<tsl::ordered_map<KT, VT, Rest...>> = sizeof(std::uint64_t);
+
+template<typename T, std::size_t N>
+inline constexpr std::size_t binary_min_size<std::array<T, N>> = N * binary_min_size<T>;
+
+template<typename T, std::size_t N>
+inline constexpr std::size_t binary_min_size<T[N]> = N * binary_min_size<T>;
+
+template<typename... Types>
+inline constexpr std::size_t binary_min_size<std::tuple<Types...>> = (std::size_t(0) + ... + binary_min_size<Types>);
+
+template<typename T>
+inline constexpr std::size_t binary_min_size<std::optional<T>> = 1;
+
+/**
+ * Reads the size of a string or container whose items take at least `item_size` bytes. Every item
+ * is counted as at least one byte, so that a corrupt size is rejected before anything is allocated
+ * or looped over for it, even for items that take no bytes like `std::tuple<>`. Containers of such
+ * items therefore can't hold more of them than there are bytes left behind them.
+ */
+inline Status read_size(BinaryInput &input, std::size_t &size, std::size_t item_size) {
+  std::uint64_t value;
+  if (Status status = read_little_endian(input, value); !status) {
+    return status;
+  }
+  if (value > input.remaining() / std::max<std::size_t>(item_size, 1)) {
+    return truncated_binary();
+  }
+  size = static_cast<std::size_t>(value);
+  return Status();
+}
+
+template<binary_memcpy_type T>
+inline void write_items(const T *input, std::size_t count, Buffer &output) {
+  const auto *bytes = reinterpret_cast<const std::byte *>(input);
+  output.insert(output.end(), bytes, bytes + count * sizeof(T));
+}
+
+template<binary_memcpy_type T>
+inline void read_items(BinaryInput &input, T *obj, std::size_t count) {
+  const std::span<const std::byte> bytes = input.take(count * sizeof(T));
+  if (!bytes.empty()) {
+    std::memcpy(obj, bytes.data(), bytes.size());
+  }
+}
+
+/**
+ * The hash of the parts of the spec that the binary encoding of the map or enum type `T` depends
+ * on, which is written to the header of `YAVL::encode`. Specializations are generated by
+ * yavl-compile.
+ */
+template<typename T>
+struct binary_schema;
+
+template<typename T>
+concept binary_schema_type = requires { binary_schema<T>::hash; };
+
+/**
+ * Encodes and decodes values of type `T` in the binary format of `YAVL::encode`. Scalars are stored
+ * little-endian with their fixed width, strings and containers behind their size as a 64 bit
+ * integer, and the fields of map types in declaration order. The specializations for map types are
+ * generated by yavl-compile. The generic version stores the YAML text of the value, so that every
+ * type that has a `YAML::convert` can be encoded, if only slowly.
+ */
+template<typename T>
+struct binary_codec;
+
+template<typename T>
+inline void write_binary(const T &input, Buffer &output) {
+  binary_codec<T>::write(input, output);
+}
+
+template<typename T>
+inline Status read_binary(BinaryInput &input, T &obj) {
+  return binary_codec<T>::read(input, obj);
+}
+
+template<binary_scalar_type T>
+struct binary_codec<T> {
+  static void write(T input, Buffer &output) {
+    write_little_endian(input, output);
+  }
+
+  static Status read(BinaryInput &input, T &obj) {
+    return read_little_endian(input, obj);
+  }
+};
+
+template<>
+struct binary_codec<bool> {
+  static void write(bool input, Buffer &output) {
+    output.push_back(std::byte(input ? 1 : 0));
+  }
+
+  static Status read(BinaryInput &input, bool &obj) {
+    if (input.remaining() < 1) {
+      return truncated_binary();
+    }
+    const std::byte value = input.take(1)[0];
+    if (value != std::byte(0) && value != std::byte(1)) {
+      return invalid_binary("bool");
+    }
+    obj = value == std::byte(1);
+    return Status();
+  }
+};
+
+template<enum_type T>
+struct binary_codec<T> {
+  static void write(T input, Buffer &output) {
+    write_little_endian(static_cast<std::uint32_t>(input), output);
+  }
+
+  static Status read(BinaryInput &input, T &obj) {
+    std::uint32_t index;
+    if (Status status = read_little_endian(input, index); !status) {
+      return status;
+    }
+    if (index >= enum_traits<T>::names.size()) {
+      return invalid_binary(enum_traits<T>::name);
+    }
+    obj = static_cast<T>(index);
+    return Status();
+  }
+};
+
+template<typename Traits, typename Allocator>
+struct binary_codec<std::basic_string<char, Traits, Allocator>> {
+  using string_type = std::basic_string<char, Traits, Allocator>;
+
+  static void write(const string_type &input, Buffer &output) {
+    write_size(input.size(), output);
+    const auto *bytes = reinterpret_cast<const std::byte *>(input.data());
+    output.insert(output.end(), bytes, bytes + input.size());
+  }
+
+  static Status read(BinaryInput &input, string_type &obj) {
+    std::size_t size;
+    if (Status status = read_size(input, size, 1); !status) {
+      return status;
+    }
+    const std::span<const std::byte> bytes = input.take(size);
+    obj.assign(reinterpret_cast<const char *>(bytes.data()), size);
+    return Status();
+  }
+};
+
+// The generic version is defined after the codec for strings, which it uses for the YAML text.
+template<typename T>
+struct binary_codec {
+  static void write(const T &input, Buffer &output) {
+    binary_codec<std::string>::write(YAML::Dump(YAML::Node(input)), output);
+  }
+
+  static Status read(BinaryInput &input, T &obj) {
+    std::string text;
+    if (Status status = binary_codec<std::string>::read(input, text); !status) {
+      return status;
+    }
+    YAML::Node node;
+#ifdef __cpp_exceptions
+    try {
+#endif
+      node = YAML::Load(text);
+#ifdef __cpp_exceptions
+    } catch (const YAML::Exception &) {
+      return Status::other("Invalid YAML text in binary data");
+    }
+#endif
+    return YAVL::decode(node, obj);
+  }
+};
+
+template<typename T, typename Allocator>
+struct binary_codec<std::vector<T, Allocator>> {
+  static void write(const std::vector<T, Allocator> &input, Buffer &output) {
+    write_size(input.size(), output);
+    if constexpr (binary_memcpy_type<T>) {
+      write_items(input.data(), input.size(), output);
+    } else {
+      for (const auto &item : input) {
+        write_binary(item, output);
+      }
+    }
+  }
+
+  // Like the YAML decoder, this decodes into the items that are already there.
+  static Status read(BinaryInput &input, std::vector<T, Allocator> &obj) {
+    std::size_t size;
+    if (Status status = read_size(input, size, binary_min_size<T>); !status) {
+      return status;
+    }
+    if constexpr (binary_memcpy_type<T>) {
+      obj.resize(size);
+      read_items(input, obj.data(), size);
+      return Status();
+    } else {
+      obj.reserve(size);
+      std::size_t count = 0;
+      for (; count < size; ++count) {
+        if constexpr (std::is_same_v<T, bool>) {
+          bool item;
+          if (Status status = read_binary(input, item); !status) {
+            return status;
+          }
+          if (count < obj.size()) {
+            obj[count] = item;
+          } else {
+            obj.push_back(item);
+          }
+        } else {
+          T &item = count < obj.size() ? obj[count] : obj.emplace_back();
+          if (Status status = read_binary(input, item); !status) {
+            return status;
+          }
+        }
+      }
+      obj.erase(obj.begin() + count, obj.end());
+      return Status();
+    }
+  }
+};
+
+// Fixed-size sequences are stored without their size.
+template<typename T, std::size_t N>
+inline void write_fixed_sequence(const T *input, Buffer &output) {
+  if constexpr (binary_memcpy_type<T>) {
+    write_items(input, N, output);
+  } else {
+    for (std::size_t i = 0; i < N; ++i) {
+      write_binary(input[i], output);
+    }
+  }
+}
+
+template<typename T, std::size_t N>
+inline Status read_fixed_sequence(BinaryInput &input, T *obj) {
+  if constexpr (binary_memcpy_type<T>) {
+    if (input.remaining() < N * sizeof(T)) {
+      return truncated_binary();
+    }
+    read_items(input, obj, N);
+  } else {
+    for (std::size_t i = 0; i < N; ++i) {
+      if (Status status = read_binary(input, obj[i]); !status) {
+        return status;
+      }
+    }
+  }
+  return Status();
+}
+
+template<typename T, std::size_t N>
+struct binary_codec<std::array<T, N>> {
+  static void write(const std::array<T, N> &input, Buffer &output) {
+    write_fixed_sequence<T, N>(input.data(), output);
+  }
+
+  static Status read(BinaryInput &input, std::array<T, N> &obj) {
+    return read_fixed_sequence<T, N>(input, obj.data());
+  }
+};
+
+template<typename T, std::size_t N>
+struct binary_codec<T[N]> {
+  static void write(const T (&input)[N], Buffer &output) {
+    write_fixed_sequence<T, N>(input, output);
+  }
+
+  static Status read(BinaryInput &input, T (&obj)[N]) {
+    return read_fixed_sequence<T, N>(input, obj);
+  }
+};
+
+template<typename Set>
+inline void write_binary_set(const Set &input, Buffer &output) {
+  write_size(input.size(), output);
+  for (const auto &item : input) {
+    write_binary(item, output);
+  }
+}
+
+/**
+ * Reads the items of a set, reporting the first item that is already contained in it. The previous
+ * items of the set are recycled with `NodeRecycler`, but without matching them to the new items,
+ * since those are only known once they are read.
+ */
+template<typename Set>
+inline Status read_binary_set(BinaryInput &input, Set &obj) {
+  std::size_t size;
+  if (Status status = read_size(input, size, binary_min_size<typename Set::value_type>); !status) {
+    return status;
+  }
+  NodeRecycler<Set> recycler(obj);
+  if constexpr (requires { obj.reserve(size); }) {
+    obj.reserve(size);
+  }
+  for (std::size_t i = 0; i < size; ++i) {
+    if (auto slot = recycler.take(i)) {
+      if (Status status = read_binary(input, slot.value()); !status) {
+        return status;
+      }
+      if (!obj.insert(std::move(slot)).inserted) {
+        return Status::duplicate_set_item(YAML::Mark::null_mark());
+      }
+      continue;
+    }
+    auto item = make_item<typename Set::value_type>(obj);
+    if (Status status = read_binary(input, item); !status) {
+      return status;
+    }
+    if (!obj.insert(std::move(item)).second) {
+      return Status::duplicate_set_item(YAML::Mark::null_mark());
+    }
+  }
+  return Status();
+}
+
+/**
+ * Reads the items of an ordered set. Items that match the previous contents of the set at the same
+ * position are kept, the remaining ones are replaced.
+ */
+template<typename Set>
+inline Status read_binary_ordered_set(BinaryInput &input, Set &obj) {
+  std::size_t size;
+  if (Status status = read_size(input, size, binary_min_size<typename Set::value_type>); !status) {
+    return status;
+  }
+  obj.reserve(size);
+  std::size_t count = 0;
+  auto item = make_item<typename Set::value_type>(obj);
+  for (; count < size; ++count) {
+    if (Status status = read_binary(input, item); !status) {
+      return status;
+    }
+    if (count < obj.size()) {
+      const auto slot = obj.nth(count);
+      if (*slot == item) {
+        continue;
+      }
+      obj.erase(slot, obj.end());
+    }
+    if (!obj.insert(std::move(item)).second) {
+      return Status::duplicate_set_item(YAML::Mark::null_mark());
+    }
+    item = make_item<typename Set::value_type>(obj);
+  }
+  obj.erase(obj.nth(count), obj.end());
+  return Status();
+}
+
+// Returns the value of the map item at `slot`, which tsl's ordered map only hands out through `value()`.
+template<typename Iterator>
+inline auto &mapped_value(Iterator slot) {
+  if constexpr (requires { slot.value(); }) {
+    return slot.value();
+  } else {
+    return slot->second;
+  }
+}
+
+template<typename Map>
+inline void write_binary_map(const Map &input, Buffer &output) {
+  write_size(input.size(), output);
+  for (const auto &[key, value] : input) {
+    write_binary(key, output);
+    write_binary(value, output);
+  }
+}
+
+/**
+ * Reads the items of a map, reporting the first key that is already contained in it. The previous
+ * items of the map are recycled with `NodeRecycler` like in `read_binary_set`.
+ */
+template<typename Map>
+inline Status read_binary_map(BinaryInput &input, Map &obj) {
+  using key_type = typename Map::key_type;
+  constexpr std::size_t item_size = binary_min_size<key_type> + binary_min_size<typename Map::mapped_type>;
+  std::size_t size;
+  if (Status status = read_size(input, size, item_size); !status) {
+    return status;
+  }
+  NodeRecycler<Map> recycler(obj);
+  if constexpr (requires { obj.reserve(size); }) {
+    obj.reserve(size);
+  }
+  for (std::size_t i = 0; i < size; ++i) {
+    if (auto slot = recycler.take(i)) {
+      if (Status status = read_binary(input, slot.key()); !status) {
+        return status;
+      }
+      if (obj.contains(slot.key())) {
+        return Status::duplicate_map_item(YAML::Mark::null_mark());
+      }
+      if (Status status = read_binary(input, slot.mapped()); !status) {
+        return status;
+      }
+      obj.insert(std::move(slot));
+      continue;
+    }
+    auto key = make_item<key_type>(obj);
+    if (Status status = read_binary(input, key); !status) {
+      return status;
+    }
+    auto [slot, inserted] = obj.try_emplace(std::move(key));
+    if (!inserted) {
+      return Status::duplicate_map_item(YAML::Mark::null_mark());
+    }
+    if (Status status = read_binary(input, mapped_value(slot)); !status) {
+      return status;
+    }
+  }
+  return Status();
+}
+
+/**
+ * Reads the items of an ordered map. The values of items whose key matches the previous contents
+ * of the map at the same position are read in place, the remaining items are replaced.
+ */
+template<typename Map>
+inline Status read_binary_ordered_map(BinaryInput &input, Map &obj) {
+  using key_type = typename Map::key_type;
+  constexpr std::size_t item_size = binary_min_size<key_type> + binary_min_size<typename Map::mapped_type>;
+  std::size_t size;
+  if (Status status = read_size(input, size, item_size); !status) {
+    return status;
+  }
+  obj.reserve(size);
+  std::size_t count = 0;
+  auto key = make_item<key_type>(obj);
+  for (; count < size; ++count) {
+    if (Status status = read_binary(input, key); !status) {
+      return status;
+    }
+    if (count < obj.size()) {
+      const auto slot = obj.nth(count);
+      // The keys before this one are distinct from it, so it can't be a duplicate.
+      if (slot->first == key) {
+        if (Status status = read_binary(input, mapped_value(slot)); !status) {
+          return status;
+        }
+        continue;
+      }
+      obj.erase(slot, obj.end());
+    }
+    auto [slot, inserted] = obj.try_emplace(std::move(key));
+    if (!inserted) {
+      return Status::duplicate_map_item(YAML::Mark::null_mark());
+    }
+    key = make_item<key_type>(obj);
+    if (Status status = read_binary(input, mapped_value(slot)); !status) {
+      return status;
+    }
+  }
+  obj.erase(obj.nth(count), obj.end());
+  return Status();
+}
+
+template<typename T, typename... Rest>
+struct binary_codec<tsl::ordered_set<T, Rest...>> {
+  static void write(const tsl::ordered_set<T, Rest...> &input, Buffer &output) {
+    write_binary_set(input, output);
+  }
+
+  static Status read(BinaryInput &input, tsl::ordered_set<T, Rest...> &obj) {
+    return read_binary_ordered_set(input, obj);
+  }
+};
+
+template<typename T, typename Compare, typename Allocator>
+struct binary_codec<std::set<T, Compare, Allocator>> {
+  static void write(const std::set<T, Compare, Allocator> &input, Buffer &output) {
+    write_binary_set(input, output);
+  }
+
+  static Status read(BinaryInput &input, std::set<T, Compare, Allocator> &obj) {
+    return read_binary_set(input, obj);
+  }
+};
+
+template<typename T, typename Hash, typename KeyEqual, typename Allocator>
+struct binary_codec<std::unordered_set<T, Hash, KeyEqual, Allocator>> {
+  static void write(const std::unordered_set<T, Hash, KeyEqual, Allocator> &input, Buffer &output) {
+    write_binary_set(input, output);
+  }
+
+  static Status read(BinaryInput &input, std::unordered_set<T, Hash, KeyEqual, Allocator> &obj) {
+    return read_binary_set(input, obj);
+  }
+};
+
+template<typename KT, typename VT, typename... Rest>
+struct binary_codec<tsl::ordered_map<KT, VT, Rest...>> {
+  static void write(const tsl::ordered_map<KT, VT, Rest...> &input, Buffer &output) {
+    write_binary_map(input, output);
+  }
+
+  static Status read(BinaryInput &input, tsl::ordered_map<KT, VT, Rest...> &obj) {
+    return read_binary_ordered_map(input, obj);
+  }
+};
+
+template<typename KT, typename VT, typename Compare, typename Allocator>
+struct binary_codec<std::map<KT, VT, Compare, Allocator>> {
+  static void write(const std::map<KT, VT, Compare, Allocator> &input, Buffer &output) {
+    write_binary_map(input, output);
+  }
+
+  static Status read(BinaryInput &input, std::map<KT, VT, Compare, Allocator> &obj) {
+    return read_binary_map(input, obj);
+  }
+};
+
+template<typename KT, typename VT, typename Hash, typename KeyEqual, typename Allocator>
+struct binary_codec<std::unordered_map<KT, VT, Hash, KeyEqual, Allocator>> {
+  static void write(const std::unordered_map<KT, VT, Hash, KeyEqual, Allocator> &input, Buffer &output) {
+    write_binary_map(input, output);
+  }
+
+  static Status read(BinaryInput &input, std::unordered_map<KT, VT, Hash, KeyEqual, Allocator> &obj) {
+    return read_binary_map(input, obj);
+  }
+};
+
+template<typename... Types>
+struct binary_codec<std::tuple<Types...>> {
+  static void write(const std::tuple<Types...> &input, Buffer &output) {
+    std::apply([&](const auto &...items) { (write_binary(items, output), ...); }, input);
+  }
+
+  static Status read(BinaryInput &input, std::tuple<Types...> &obj) {
+    Status status;
+    std::apply([&](auto &...items) { (void)((status = read_binary(input, items)).ok() && ...); }, obj);
+    return status;
+  }
+};
+
+template<typename T>
+struct binary_codec<std::optional<T>> {
+  static void write(const std::optional<T> &input, Buffer &output) {
+    binary_codec<bool>::write(input.has_value(), output);
+    if (input) {
+      write_binary(*input, output);
+    }
+  }
+
+  static Status read(BinaryInput &input, std::optional<T> &obj) {
+    bool has_value;
+    if (Status status = binary_codec<bool>::read(input, has_value); !status) {
+      return status;
+    }
+    if (!has_value) {
+      obj = std::nullopt;
+      return Status();
+    }
+    return read_binary(input, ensure_value(obj));
+  }
+};
+
+// A lazy value is stored decoded, so it isn't lazy anymore after a round trip.
+template<typename T>
+struct binary_codec<lazy<T>> {
+  static void write(const lazy<T> &input, Buffer &output) {
+    write_binary(*input, output);
+  }
+
+  static Status read(BinaryInput &input, lazy<T> &obj) {
+    obj.reset(YAML::Node());
+    if (Status status = read_binary(input, obj.state->value); !status) {
+      return status;
+    }
+    obj.state->loaded.store(true, std::memory_order_relaxed);
+    return Status();
+  }
+};
+
+inline constexpr std::array<std::byte, 4> binary_magic
+    = {std::byte('Y'), std::byte('A'), std::byte('V'), std::byte('B')};
+
+inline constexpr std::uint32_t binary_format_version = 1;
+
+/**
+ * Appends the binary encoding of `input` to `output`. The encoding starts with a header that holds
+ * the schema hash of `T`, so that it is only decoded by a program that was compiled from a spec
+ * with the same definition of `T`. The encoding doesn't depend on the allocators of the containers,
+ * so a value encoded by a program generated with `--pmr` can be decoded by one without it.
+ *
+ *     YAVL::Buffer buffer;
+ *     YAVL::encode(top, buffer);
+ *     YAVL::Status status = YAVL::decode(std::span<const std::byte>(buffer), top);
+ */
+template<binary_schema_type T>
+inline void encode(const T &input, Buffer &output) {
+  output.insert(output.end(), binary_magic.begin(), binary_magic.end());
+  write_little_endian(binary_format_version, output);
+  write_little_endian(binary_schema<T>::hash, output);
+  write_binary(input, output);
+}
+
+/**
+ * Decodes the binary encoding `data` made by `YAVL::encode` into `obj`.
+ */
+template<binary_schema_type T>
+inline Status decode(std::span<const std::byte> data, T &obj) {
+  BinaryInput input(data);
+  if (input.remaining() < binary_magic.size() || !std::ranges::equal(input.take(binary_magic.size()), binary_magic)) {
+    return Status::other("Not a binary encoding of yavl-cpp");
+  }
+  std::uint32_t version;
+  std::uint64_t hash;
+  if (Status status = read_little_endian(input, version); !status) {
+    return status;
+  }
+  if (Status status = read_little_endian(input, hash); !status) {
+    return status;
+  }
+  if (version != binary_format_version || hash != binary_schema<T>::hash) {
+    return Status::other("The binary encoding was made from a different schema of the type");
+  }
+  if (Status status = read_binary(input, obj); !status) {
+    return status;
+  }
+  if (input.remaining() > 0) {
+    return Status::other("Unexpected data after the end of the binary encoding");
+  }
+  return Status();
+}
+
+} // namespace YAVL
+
+#ifdef __cpp_exceptions
+
+namespace YAVL {
+
+template<typename T>
+class NodeConversionFrame;
+
+template<typename T>
+struct event_reader {
+  static void read_scalar(const YAML::Mark &mark, const std::string &value, T &obj) {
+    read_node(mark, YAML::Node(value), obj);
+  }
+
+  static void read_null(const YAML::Mark &mark, T &obj) {
+    read_node(mark, YAML::Node(YAML::NodeType::Null), obj);
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, T &obj) {
+    return std::make_unique<NodeConversionFrame<T>>(&obj, mark, YAML::NodeType::Sequence);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, T &obj) {
+    return std::make_unique<NodeConversionFrame<T>>(&obj, mark, YAML::NodeType::Map);
+  }
+
+  static void read_node(const YAML::Mark &mark, const YAML::Node &node, T &obj) {
+    // A detached node has no position, so report the position of the event instead.
+    decode(node, obj).locate(mark).throw_on_error();
+  }
+};
+
+template<typename Traits, typename Allocator>
+struct event_reader<std::basic_string<char, Traits, Allocator>> {
+  using string_type = std::basic_string<char, Traits, Allocator>;
+
+  static void read_scalar(const YAML::Mark &, const std::string &value, string_type &obj) {
+    obj.assign(value);
+  }
+
+  static void read_null(const YAML::Mark &, string_type &obj) {
+    obj = "null";
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, string_type &) {
+    throw YAML::TypedBadConversion<std::string>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, string_type &) {
+    throw YAML::TypedBadConversion<std::string>(mark);
+  }
+};
+
+template<number_type T>
+struct event_reader<T> {
+  static void read_scalar(const YAML::Mark &mark, const std::string &value, T &obj) {
+    if (!parse_number(std::string_view(value), obj)) {
+      throw YAML::TypedBadConversion<T>(mark);
+    }
+  }
+
+  static void read_null(const YAML::Mark &mark, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+};
+
+template<enum_type T>
+struct event_reader<T> {
+  static void read_scalar(const YAML::Mark &mark, const std::string &value, T &obj) {
+    if (const std::optional<T> choice = from_string_view<T>(value)) {
+      obj = *choice;
+      return;
+    }
+    Status::bad_conversion(value, enum_traits<T>::info, mark).throw_on_error();
+  }
+
+  static void read_null(const YAML::Mark &mark, T &) {
+    Status::bad_conversion("null", enum_traits<T>::info, mark).throw_on_error();
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+};
+
+/**
+ * Decodes a single value (e.g. a whole document) into `obj`.
+ */
+template<typename T>
+class ValueFrame : public EventFrame {
+  public:
+    explicit ValueFrame(T &obj) : obj(obj) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      event_reader<T>::read_scalar(mark, value, obj);
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      event_reader<T>::read_null(mark, obj);
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      return event_reader<T>::read_sequence(mark, obj);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      return event_reader<T>::read_map(mark, obj);
+    }
+
+  private:
+    T &obj;
+};
+
+/**
+ * Base for frames whose children are all of type `T`. `next()` selects where the next child is
+ * decoded to, `commit()` is called once it has been decoded completely.
+ */
+template<typename T>
+class ElementFrame : public EventFrame {
+  public:
+    void on_scalar(const YAML::Mark &mark, const std::string &value) final {
+      event_reader<T>::read_scalar(mark, value, next());
+      commit(mark);
+    }
+
+    void on_null(const YAML::Mark &mark) final {
+      event_reader<T>::read_null(mark, next());
+      commit(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) final {
+      child_mark = mark;
+      return event_reader<T>::read_sequence(mark, next());
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) final {
+      child_mark = mark;
+      return event_reader<T>::read_map(mark, next());
+    }
+
+    void on_child_end() final {
+      commit(child_mark);
+    }
+
+  protected:
+    virtual T &next() = 0;
+    virtual void commit(const YAML::Mark &) {}
+
+  private:
+    YAML::Mark child_mark;
+};
+
+template<typename Vector>
+class VectorFrame : public ElementFrame<typename Vector::value_type> {
+  public:
+    using value_type = typename Vector::value_type;
+
+    VectorFrame(Vector &obj, const YAML::Mark &) : obj(obj) {}
+
+    void on_end() override {
+      obj.erase(obj.begin() + count, obj.end());
+    }
+
+  protected:
+    // Reuses the elements that are already there, like `decoder<std::vector<T>>`.
+    value_type &next() override {
+      return count++ < obj.size() ? obj[count - 1] : obj.emplace_back();
+    }
+
+  private:
+    Vector &obj;
+    std::size_t count = 0;
+};
+
+template<typename T, std::size_t N>
+class ArrayFrame : public ElementFrame<T> {
+  public:
+    ArrayFrame(T *obj, const YAML::Mark &mark) : obj(obj), mark(mark) {}
+
+    void on_end() override {
+      if (count != N) {
+        throw InvalidSequenceLengthException(N, count, mark);
+      }
+    }
+
+  protected:
+    T &next() override {
+      // Surplus items are still decoded to be able to report the actual length.
+      return count++ < N ? obj[count - 1] : surplus;
+    }
+
+  private:
+    T *obj;
+    YAML::Mark mark;
+    std::size_t count = 0;
+    T surplus;
+};
+
+template<typename Set>
+class SetFrame : public ElementFrame<typename Set::value_type> {
+  public:
+    using value_type = typename Set::value_type;
+
+    SetFrame(Set &obj, const YAML::Mark &) : obj(obj), element(make_item<value_type>(obj)) {
+      obj.clear();
+    }
+
+  protected:
+    value_type &next() override {
+      return element;
+    }
+
+    void commit(const YAML::Mark &mark) override {
+      if (!obj.insert(std::move(element)).second) {
+        throw DuplicateSetItemException(mark);
+      }
+      element = make_item<value_type>(obj);
+    }
+
+  private:
+    Set &obj;
+    value_type element;
+};
+
+template<typename Map>
+class MapFrame : public EventFrame {
+  public:
+    using key_type = typename Map::key_type;
+    using mapped_type = typename Map::mapped_type;
+
+    MapFrame(Map &obj, const YAML::Mark &) : obj(obj), key(make_item<key_type>(obj)) {
+      obj.clear();
+    }
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      if (expect_key) {
+        event_reader<key_type>::read_scalar(mark, value, key);
+        insert(mark);
+      } else {
+        event_reader<mapped_type>::read_scalar(mark, value, *value_slot);
+        expect_key = true;
+      }
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      if (expect_key) {
+        event_reader<key_type>::read_null(mark, key);
+        insert(mark);
+      } else {
+        event_reader<mapped_type>::read_null(mark, *value_slot);
+        expect_key = true;
+      }
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      key_mark = mark;
+      if (expect_key) {
+        return event_reader<key_type>::read_sequence(mark, key);
+      }
+      return event_reader<mapped_type>::read_sequence(mark, *value_slot);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      key_mark = mark;
+      if (expect_key) {
+        return event_reader<key_type>::read_map(mark, key);
+      }
+      return event_reader<mapped_type>::read_map(mark, *value_slot);
+    }
+
+    void on_child_end() override {
+      if (expect_key) {
+        insert(key_mark);
+      } else {
+        expect_key = true;
+      }
+    }
+
+  private:
+    void insert(const YAML::Mark &mark) {
+      auto [it, inserted] = obj.try_emplace(std::move(key));
+      if (!inserted) {
+        throw DuplicateMapItemException(mark);
+      }
+      if constexpr (requires { it.value(); }) {
+        value_slot = &it.value();
+      } else {
+        value_slot = &it->second;
+      }
+      key = make_item<key_type>(obj);
+      expect_key = false;
+    }
+
+    Map &obj;
+    key_type key;
+    mapped_type *value_slot = nullptr;
+    bool expect_key = true;
+    YAML::Mark key_mark;
+};
+
+template<typename... Types>
+class TupleFrame : public EventFrame {
+  public:
+    TupleFrame(std::tuple<Types...> &obj, const YAML::Mark &mark) : obj(obj), mark(mark) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      visit_next([&](auto &element) {
+        event_reader<std::remove_reference_t<decltype(element)>>::read_scalar(mark, value, element);
+      });
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      visit_next([&](auto &element) {
+        event_reader<std::remove_reference_t<decltype(element)>>::read_null(mark, element);
+      });
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child = std::make_unique<SkipFrame>();
+      visit_next([&](auto &element) {
+        child = event_reader<std::remove_reference_t<decltype(element)>>::read_sequence(mark, element);
+      });
+      return child;
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child = std::make_unique<SkipFrame>();
+      visit_next([&](auto &element) {
+        child = event_reader<std::remove_reference_t<decltype(element)>>::read_map(mark, element);
+      });
+      return child;
+    }
+
+    void on_end() override {
+      if (count != sizeof...(Types)) {
+        throw InvalidSequenceLengthException(sizeof...(Types), count, mark);
+      }
+    }
+
+  private:
+    template<typename F>
+    void visit_next(F &&f) {
+      visit_element(count++, f, std::index_sequence_for<Types...>());
+    }
+
+    template<typename F, std::size_t... I>
+    void visit_element(std::size_t index, F &f, std::index_sequence<I...>) {
+      ((index == I ? (f(std::get<I>(obj)), true) : false) || ...);
+    }
+
+    std::tuple<Types...> &obj;
+    YAML::Mark mark;
+    std::size_t count = 0;
+};
+
+/**
+ * Handles the keys of a generated map type. Derived frames handle the value of the field `index`.
+ */
+template<typename T>
+class MapTypeFrameBase : public EventFrame {
+  public:
+    using traits = map_traits<T>;
+
+    explicit MapTypeFrameBase(const YAML::Mark &mark) : mark(mark) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) final {
+      if (expect_key) {
+        select(mark, value);
+        expect_key = false;
+        return;
+      }
+      expect_key = true;
+      if (index != npos) {
+        value_scalar(mark, value);
+      }
+    }
+
+    void on_null(const YAML::Mark &mark) final {
+      if (expect_key) {
+        throw YAML::BadConversion(mark);
+      }
+      expect_key = true;
+      if (index != npos) {
+        value_null(mark);
+      }
+    }
+
+    // Keys have to be scalars, like in the generated readers.
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) final {
+      if (expect_key) {
+        throw YAML::BadConversion(mark);
+      }
+      if (index != npos) {
+        return value_sequence(mark);
+      }
+      return std::make_unique<SkipFrame>();
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) final {
+      if (expect_key) {
+        throw YAML::BadConversion(mark);
+      }
+      if (index != npos) {
+        return value_map(mark);
+      }
+      return std::make_unique<SkipFrame>();
+    }
+
+    void on_child_end() final {
+      expect_key = !expect_key;
+    }
+
+    void on_end() final {
+      for (std::size_t i = 0; i < traits::keys.size(); ++i) {
+        if (found.test(i)) {
+          continue;
+        }
+        if (traits::required[i]) {
+          Status::missing_key(traits::info, i, mark).throw_on_error();
+        }
+        missing(i);
+      }
+      if (superfluous_key) {
+        Status::superfluous_key(traits::info, *superfluous_key, superfluous_mark).throw_on_error();
+      }
+    }
+
+  protected:
+    virtual void value_scalar(const YAML::Mark &mark, const std::string &value) = 0;
+    virtual void value_null(const YAML::Mark &mark) = 0;
+    virtual std::unique_ptr<EventFrame> value_sequence(const YAML::Mark &mark) = 0;
+    virtual std::unique_ptr<EventFrame> value_map(const YAML::Mark &mark) = 0;
+    // Called for every optional field that did not occur.
+    virtual void missing(std::size_t) {}
+
+    std::size_t index = npos;
+
+  private:
+    void select(const YAML::Mark &mark, const std::string &key) {
+      index = key_index<T>(key);
+      if (index == npos) {
+        if (!superfluous_key) {
+          superfluous_key = key;
+          superfluous_mark = mark;
+        }
+        return;
+      }
+      if (found.test(index)) {
+        throw DuplicateMapItemException(mark);
+      }
+      found.set(index);
+    }
+
+    YAML::Mark mark;
+    std::bitset<traits::keys.size()> found;
+    bool expect_key = true;
+    std::optional<std::string> superfluous_key;
+    YAML::Mark superfluous_mark;
+};
+
+template<typename T>
+class MapTypeFrame : public MapTypeFrameBase<T> {
+  public:
+    using traits = map_traits<T>;
+
+    MapTypeFrame(T &obj, const YAML::Mark &mark) : MapTypeFrameBase<T>(mark), obj(obj) {}
+
+  protected:
+    void value_scalar(const YAML::Mark &mark, const std::string &value) override {
+      traits::visit(obj, this->index, [&](auto &field) {
+        event_reader<std::remove_reference_t<decltype(field)>>::read_scalar(mark, value, field);
+      });
+    }
+
+    void value_null(const YAML::Mark &mark) override {
+      traits::visit(obj, this->index, [&](auto &field) {
+        event_reader<std::remove_reference_t<decltype(field)>>::read_null(mark, field);
+      });
+    }
+
+    std::unique_ptr<EventFrame> value_sequence(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child;
+      traits::visit(obj, this->index, [&](auto &field) {
+        child = event_reader<std::remove_reference_t<decltype(field)>>::read_sequence(mark, field);
+      });
+      return child;
+    }
+
+    std::unique_ptr<EventFrame> value_map(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child;
+      traits::visit(obj, this->index, [&](auto &field) {
+        child = event_reader<std::remove_reference_t<decltype(field)>>::read_map(mark, field);
+      });
+      return child;
+    }
+
+    void missing(std::size_t index) override {
+      traits::visit(obj, index, [](auto &field) {
+        if constexpr (is_optional<std::remove_reference_t<decltype(field)>>::value) {
+          field = std::nullopt;
+        }
+      });
+    }
+
+  private:
+    T &obj;
+};
+
+/**
+ * Builds a YAML::Node from the children of a sequence or mapping.
+ */
+class NodeFrame : public EventFrame {
+  public:
+    // Assigning to a YAML::Node changes the node it refers to, which may already be part of the
+    // tree, so the members are rebound with `reset` instead.
+    NodeFrame(YAML::Node &obj, YAML::NodeType::value type) : obj(obj) {
+      obj.reset(YAML::Node(type));
+    }
+
+    void on_scalar(const YAML::Mark &, const std::string &value) override {
+      add(YAML::Node(value));
+    }
+
+    void on_null(const YAML::Mark &) override {
+      add(YAML::Node(YAML::NodeType::Null));
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &) override {
+      return std::make_unique<NodeFrame>(child, YAML::NodeType::Sequence);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &) override {
+      return std::make_unique<NodeFrame>(child, YAML::NodeType::Map);
+    }
+
+    void on_child_end() override {
+      add(child);
+    }
+
+  private:
+    void add(const YAML::Node &node) {
+      if (obj.IsSequence()) {
+        obj.push_back(node);
+      } else if (has_key) {
+        obj.force_insert(key, node);
+        has_key = false;
+      } else {
+        key.reset(node);
+        has_key = true;
+      }
+    }
+
+    YAML::Node &obj;
+    YAML::Node key;
+    YAML::Node child;
+    bool has_key = false;
+};
+
+/**
+ * Collects the children of a sequence or mapping into a YAML::Node and converts it to `T` at
+ * the end. This is the fallback for types that don't have a dedicated event reader, e.g. types
+ * with their own `YAML::convert`. The whole subtree is kept until it ends, so it takes as much
+ * memory as with `decode()`. If `obj` is null, the converted value is discarded.
+ */
+template<typename T>
+class NodeConversionFrame : public EventFrame {
+  public:
+    NodeConversionFrame(T *obj, const YAML::Mark &mark, YAML::NodeType::value type)
+        : obj(obj), mark(mark), builder(node, type) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      builder.on_scalar(mark, value);
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      builder.on_null(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      return builder.on_sequence_start(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      return builder.on_map_start(mark);
+    }
+
+    void on_child_end() override {
+      builder.on_child_end();
+    }
+
+    void on_end() override {
+      if (obj) {
+        event_reader<T>::read_node(mark, node, *obj);
+      } else {
+        T tmp;
+        event_reader<T>::read_node(mark, node, tmp);
+      }
+    }
+
+  private:
+    T *obj;
+    YAML::Mark mark;
+    YAML::Node node;
+    NodeFrame builder;
+};
+
+template<>
+struct event_reader<YAML::Node> {
+  static void read_scalar(const YAML::Mark &, const std::string &value, YAML::Node &obj) {
+    obj = YAML::Node(value);
+  }
+
+  static void read_null(const YAML::Mark &, YAML::Node &obj) {
+    obj = YAML::Node(YAML::NodeType::Null);
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &, YAML::Node &obj) {
+    return std::make_unique<NodeFrame>(obj, YAML::NodeType::Sequence);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &, YAML::Node &obj) {
+    return std::make_unique<NodeFrame>(obj, YAML::NodeType::Map);
+  }
+};
+
+/**
+ * Reader for types that are represented as YAML sequences and decoded by `Frame`.
+ * A null value is treated like an empty sequence.
+ */
+template<typename T, typename Frame>
+struct sequence_event_reader {
+  static void read_scalar(const YAML::Mark &mark, const std::string &, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static void read_null(const YAML::Mark &mark, T &obj) {
+    Frame(obj, mark).on_end();
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, T &obj) {
+    return std::make_unique<Frame>(obj, mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+};
+
+/**
+ * Reader for types that are represented as YAML mappings and decoded by `Frame`.
+ * A null value is treated like an empty mapping.
+ */
+template<typename T, typename Frame>
+struct mapping_event_reader {
+  static void read_scalar(const YAML::Mark &mark, const std::string &, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static void read_null(const YAML::Mark &mark, T &obj) {
+    Frame(obj, mark).on_end();
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, T &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, T &obj) {
+    return std::make_unique<Frame>(obj, mark);
+  }
+};
+
+template<typename T, typename Allocator>
+struct event_reader<std::vector<T, Allocator>>
+    : sequence_event_reader<std::vector<T, Allocator>, VectorFrame<std::vector<T, Allocator>>> {};
+
+template<typename T, std::size_t N>
+struct event_reader<std::array<T, N>> {
+  using frame = ArrayFrame<T, N>;
+
+  static void read_scalar(const YAML::Mark &mark, const std::string &, std::array<T, N> &) {
+    throw YAML::TypedBadConversion<std::array<T, N>>(mark);
+  }
+
+  static void read_null(const YAML::Mark &mark, std::array<T, N> &obj) {
+    frame(obj.data(), mark).on_end();
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, std::array<T, N> &obj) {
+    return std::make_unique<frame>(obj.data(), mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, std::array<T, N> &) {
+    throw YAML::TypedBadConversion<std::array<T, N>>(mark);
+  }
+};
+
+template<typename T, std::size_t N>
+struct event_reader<T[N]> {
+  using frame = ArrayFrame<T, N>;
+
+  static void read_scalar(const YAML::Mark &mark, const std::string &, T (&)[N]) {
+    throw YAML::TypedBadConversion<T[N]>(mark);
+  }
+
+  static void read_null(const YAML::Mark &mark, T (&obj)[N]) {
+    frame(obj, mark).on_end();
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, T (&obj)[N]) {
+    return std::make_unique<frame>(obj, mark);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, T (&)[N]) {
+    throw YAML::TypedBadConversion<T[N]>(mark);
+  }
+};
+
+template<typename T, typename... Rest>
+struct event_reader<tsl::ordered_set<T, Rest...>>
+    : sequence_event_reader<tsl::ordered_set<T, Rest...>, SetFrame<tsl::ordered_set<T, Rest...>>> {};
+
+template<typename T, typename Compare, typename Allocator>
+struct event_reader<std::set<T, Compare, Allocator>>
+    : sequence_event_reader<std::set<T, Compare, Allocator>, SetFrame<std::set<T, Compare, Allocator>>> {};
+
+template<typename T, typename Hash, typename KeyEqual, typename Allocator>
+struct event_reader<std::unordered_set<T, Hash, KeyEqual, Allocator>>
+    : sequence_event_reader<std::unordered_set<T, Hash, KeyEqual, Allocator>,
+          SetFrame<std::unordered_set<T, Hash, KeyEqual, Allocator>>> {};
+
+template<typename KT, typename VT, typename... Rest>
+struct event_reader<tsl::ordered_map<KT, VT, Rest...>>
+    : mapping_event_reader<tsl::ordered_map<KT, VT, Rest...>, MapFrame<tsl::ordered_map<KT, VT, Rest...>>> {};
+
+template<typename KT, typename VT, typename Compare, typename Allocator>
+struct event_reader<std::map<KT, VT, Compare, Allocator>>
+    : mapping_event_reader<std::map<KT, VT, Compare, Allocator>, MapFrame<std::map<KT, VT, Compare, Allocator>>> {};
+
+template<typename KT, typename VT, typename Hash, typename KeyEqual, typename Allocator>
+struct event_reader<std::unordered_map<KT, VT, Hash, KeyEqual, Allocator>>
+    : mapping_event_reader<std::unordered_map<KT, VT, Hash, KeyEqual, Allocator>,
+          MapFrame<std::unordered_map<KT, VT, Hash, KeyEqual, Allocator>>> {};
+
+template<typename... Types>
+struct event_reader<std::tuple<Types...>>
+    : sequence_event_reader<std::tuple<Types...>, TupleFrame<Types...>> {};
+
+template<typename T>
+struct event_reader<std::optional<T>> {
+  static void read_scalar(const YAML::Mark &mark, const std::string &value, std::optional<T> &obj) {
+    event_reader<T>::read_scalar(mark, value, ensure_value(obj));
+  }
+
+  static void read_null(const YAML::Mark &, std::optional<T> &obj) {
+    obj = std::nullopt;
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &mark, std::optional<T> &obj) {
+    return event_reader<T>::read_sequence(mark, ensure_value(obj));
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &mark, std::optional<T> &obj) {
+    return event_reader<T>::read_map(mark, ensure_value(obj));
+  }
+};
+
+template<map_type T>
+struct event_reader<T> : mapping_event_reader<T, MapTypeFrame<T>> {
+  // Names the value and the type like the generated decoder does.
+  static void read_scalar(const YAML::Mark &mark, const std::string &value, T &) {
+    Status::bad_conversion(value, map_traits<T>::info, mark).throw_on_error();
+  }
+};
+
+/**
+ * Keeps the children of a `lazy` value as a YAML::Node. Since the node is built from the events, it
+ * has no positions, so errors found when it is decoded later are reported without one.
+ */
+template<typename T>
+struct event_reader<lazy<T>> {
+  static void read_scalar(const YAML::Mark &, const std::string &value, lazy<T> &obj) {
+    obj.reset(YAML::Node(value));
+  }
+
+  static void read_null(const YAML::Mark &, lazy<T> &obj) {
+    obj.reset(YAML::Node(YAML::NodeType::Null));
+  }
+
+  static std::unique_ptr<EventFrame> read_sequence(const YAML::Mark &, lazy<T> &obj) {
+    obj.reset(YAML::Node());
+    return std::make_unique<NodeFrame>(obj.state->node, YAML::NodeType::Sequence);
+  }
+
+  static std::unique_ptr<EventFrame> read_map(const YAML::Mark &, lazy<T> &obj) {
+    obj.reset(YAML::Node());
+    return std::make_unique<NodeFrame>(obj.state->node, YAML::NodeType::Map);
+  }
+};
+
+/**
+ * Checks whether a value could be decoded to type `T` from parser events, without keeping the
+ * decoded value. The interface mirrors `event_reader<T>`. Scalars are converted to a temporary
+ * `T` and discarded, containers only keep the state that is needed to check their length.
+ * Sets and maps remember their scalar items and keys to detect duplicates, see `ScalarItems`.
+ * Duplicate items that are sequences or mappings are not detected, since that would require
+ * decoding them.
+ */
+template<typename T>
+struct event_validator {
+  static void check_scalar(const YAML::Mark &mark, const std::string &value) {
+    T tmp;
+    event_reader<T>::read_scalar(mark, value, tmp);
+  }
+
+  static void check_null(const YAML::Mark &mark) {
+    T tmp;
+    event_reader<T>::read_null(mark, tmp);
+  }
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &mark) {
+    return std::make_unique<NodeConversionFrame<T>>(nullptr, mark, YAML::NodeType::Sequence);
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &mark) {
+    return std::make_unique<NodeConversionFrame<T>>(nullptr, mark, YAML::NodeType::Map);
+  }
+};
+
+template<typename Traits, typename Allocator>
+struct event_validator<std::basic_string<char, Traits, Allocator>> {
+  static void check_scalar(const YAML::Mark &, const std::string &) {}
+
+  static void check_null(const YAML::Mark &) {}
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<std::string>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<std::string>(mark);
+  }
+};
+
+template<number_type T>
+struct event_validator<T> {
+  static void check_scalar(const YAML::Mark &mark, const std::string &value) {
+    T tmp;
+    event_reader<T>::read_scalar(mark, value, tmp);
+  }
+
+  static void check_null(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+};
+
+template<enum_type T>
+struct event_validator<T> {
+  static void check_scalar(const YAML::Mark &mark, const std::string &value) {
+    T tmp;
+    event_reader<T>::read_scalar(mark, value, tmp);
+  }
+
+  static void check_null(const YAML::Mark &mark) {
+    T tmp;
+    event_reader<T>::read_null(mark, tmp);
+  }
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+};
+
+template<>
+struct event_validator<YAML::Node> {
+  static void check_scalar(const YAML::Mark &, const std::string &) {}
+
+  static void check_null(const YAML::Mark &) {}
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &) {
+    return std::make_unique<SkipFrame>();
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &) {
+    return std::make_unique<SkipFrame>();
+  }
+};
+
+/**
+ * Checks a single value (e.g. a whole document).
+ */
+template<typename T>
+class ValueCheckFrame : public EventFrame {
+  public:
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      event_validator<T>::check_scalar(mark, value);
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      event_validator<T>::check_null(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      return event_validator<T>::check_sequence(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      return event_validator<T>::check_map(mark);
+    }
+};
+
+/**
+ * Checks a sequence whose items are all of type `T`. If `N` is not `npos`, the sequence must
+ * have exactly `N` items.
+ */
+template<typename T, std::size_t N = npos>
+class SequenceCheckFrame : public EventFrame {
+  public:
+    explicit SequenceCheckFrame(const YAML::Mark &mark) : mark(mark) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      ++count;
+      event_validator<T>::check_scalar(mark, value);
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      ++count;
+      event_validator<T>::check_null(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      ++count;
+      return event_validator<T>::check_sequence(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      ++count;
+      return event_validator<T>::check_map(mark);
+    }
+
+    void on_end() override {
+      if (N != npos && count != N) {
+        throw InvalidSequenceLengthException(N, count, mark);
+      }
+    }
+
+  private:
+    YAML::Mark mark;
+    std::size_t count = 0;
+};
+
+/**
+ * Types whose values are remembered by `ScalarItems`.
+ */
+template<typename T>
+concept scalar_item_type = number_type<T> || enum_type<T> || std::is_same_v<T, bool> || std::is_same_v<T, std::string>
+    || std::is_same_v<T, std::pmr::string>;
+
+/**
+ * Checks the scalar items of a set or the scalar keys of a map, and reports the first one that is
+ * equal to a previous one like the decoders do. The items are compared after they are converted to
+ * `T`, so `1` and `0x1` are duplicates of type `int`. Only the items of the types in
+ * `scalar_item_type` are remembered.
+ */
+template<typename T, typename Exception>
+class ScalarItems {
+  public:
+    void check_scalar(const YAML::Mark &mark, const std::string &value) {
+      if constexpr (scalar_item_type<T>) {
+        T item;
+        event_reader<T>::read_scalar(mark, value, item);
+        insert(mark, std::move(item));
+      } else {
+        event_validator<T>::check_scalar(mark, value);
+      }
+    }
+
+    void check_null(const YAML::Mark &mark) {
+      if constexpr (scalar_item_type<T>) {
+        T item;
+        event_reader<T>::read_null(mark, item);
+        insert(mark, std::move(item));
+      } else {
+        event_validator<T>::check_null(mark);
+      }
+    }
+
+  private:
+    void insert(const YAML::Mark &mark, T &&item) {
+      if (!seen.insert(std::move(item)).second) {
+        throw Exception(mark);
+      }
+    }
+
+    [[no_unique_address]] std::conditional_t<scalar_item_type<T>, std::set<T>, std::tuple<>> seen;
+};
+
+/**
+ * Checks a set whose items are all of type `T`.
+ */
+template<typename T>
+class SetCheckFrame : public EventFrame {
+  public:
+    explicit SetCheckFrame(const YAML::Mark &) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      items.check_scalar(mark, value);
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      items.check_null(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      return event_validator<T>::check_sequence(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      return event_validator<T>::check_map(mark);
+    }
+
+  private:
+    ScalarItems<T, DuplicateSetItemException> items;
+};
+
+template<typename KT, typename VT>
+class MapCheckFrame : public EventFrame {
+  public:
+    explicit MapCheckFrame(const YAML::Mark &) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      if (expect_key) {
+        keys.check_scalar(mark, value);
+      } else {
+        event_validator<VT>::check_scalar(mark, value);
+      }
+      expect_key = !expect_key;
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      if (expect_key) {
+        keys.check_null(mark);
+      } else {
+        event_validator<VT>::check_null(mark);
+      }
+      expect_key = !expect_key;
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      if (expect_key) {
+        return event_validator<KT>::check_sequence(mark);
+      }
+      return event_validator<VT>::check_sequence(mark);
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      if (expect_key) {
+        return event_validator<KT>::check_map(mark);
+      }
+      return event_validator<VT>::check_map(mark);
+    }
+
+    void on_child_end() override {
+      expect_key = !expect_key;
+    }
+
+  private:
+    ScalarItems<KT, DuplicateMapItemException> keys;
+    bool expect_key = true;
+};
+
+template<typename... Types>
+class TupleCheckFrame : public EventFrame {
+  public:
+    explicit TupleCheckFrame(const YAML::Mark &mark) : mark(mark) {}
+
+    void on_scalar(const YAML::Mark &mark, const std::string &value) override {
+      visit_next([&](auto type) {
+        event_validator<typename decltype(type)::type>::check_scalar(mark, value);
+      });
+    }
+
+    void on_null(const YAML::Mark &mark) override {
+      visit_next([&](auto type) {
+        event_validator<typename decltype(type)::type>::check_null(mark);
+      });
+    }
+
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child = std::make_unique<SkipFrame>();
+      visit_next([&](auto type) {
+        child = event_validator<typename decltype(type)::type>::check_sequence(mark);
+      });
+      return child;
+    }
+
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child = std::make_unique<SkipFrame>();
+      visit_next([&](auto type) {
+        child = event_validator<typename decltype(type)::type>::check_map(mark);
+      });
+      return child;
+    }
+
+    void on_end() override {
+      if (count != sizeof...(Types)) {
+        throw InvalidSequenceLengthException(sizeof...(Types), count, mark);
+      }
+    }
+
+  private:
+    template<typename F>
+    void visit_next(F &&f) {
+      visit_element(count++, f, std::index_sequence_for<Types...>());
+    }
+
+    template<typename F, std::size_t... I>
+    void visit_element(std::size_t index, F &f, std::index_sequence<I...>) {
+      (void)((index == I ? (f(std::type_identity<Types>()), true) : false) || ...);
+    }
+
+    YAML::Mark mark;
+    std::size_t count = 0;
+};
+
+template<typename T>
+class MapTypeCheckFrame : public MapTypeFrameBase<T> {
+  public:
+    using traits = map_traits<T>;
+
+    explicit MapTypeCheckFrame(const YAML::Mark &mark) : MapTypeFrameBase<T>(mark) {}
+
+  protected:
+    void value_scalar(const YAML::Mark &mark, const std::string &value) override {
+      traits::visit_type(this->index, [&](auto type) {
+        event_validator<typename decltype(type)::type>::check_scalar(mark, value);
+      });
+    }
+
+    void value_null(const YAML::Mark &mark) override {
+      traits::visit_type(this->index, [&](auto type) {
+        event_validator<typename decltype(type)::type>::check_null(mark);
+      });
+    }
+
+    std::unique_ptr<EventFrame> value_sequence(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child;
+      traits::visit_type(this->index, [&](auto type) {
+        child = event_validator<typename decltype(type)::type>::check_sequence(mark);
+      });
+      return child;
+    }
+
+    std::unique_ptr<EventFrame> value_map(const YAML::Mark &mark) override {
+      std::unique_ptr<EventFrame> child;
+      traits::visit_type(this->index, [&](auto type) {
+        child = event_validator<typename decltype(type)::type>::check_map(mark);
+      });
+      return child;
+    }
+};
+
+/**
+ * Validator for types that are represented as YAML sequences and checked by `Frame`.
+ */
+template<typename T, typename Frame>
+struct sequence_event_validator {
+  static void check_scalar(const YAML::Mark &mark, const std::string &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static void check_null(const YAML::Mark &mark) {
+    Frame(mark).on_end();
+  }
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &mark) {
+    return std::make_unique<Frame>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+};
+
+/**
+ * Validator for types that are represented as YAML mappings and checked by `Frame`.
+ */
+template<typename T, typename Frame>
+struct mapping_event_validator {
+  static void check_scalar(const YAML::Mark &mark, const std::string &) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static void check_null(const YAML::Mark &mark) {
+    Frame(mark).on_end();
+  }
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &mark) {
+    throw YAML::TypedBadConversion<T>(mark);
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &mark) {
+    return std::make_unique<Frame>(mark);
+  }
+};
+
+template<typename T, typename Allocator>
+struct event_validator<std::vector<T, Allocator>>
+    : sequence_event_validator<std::vector<T, Allocator>, SequenceCheckFrame<T>> {};
+
+template<typename T, std::size_t N>
+struct event_validator<std::array<T, N>> : sequence_event_validator<std::array<T, N>, SequenceCheckFrame<T, N>> {};
+
+template<typename T, std::size_t N>
+struct event_validator<T[N]> : sequence_event_validator<T[N], SequenceCheckFrame<T, N>> {};
+
+template<typename T, typename... Rest>
+struct event_validator<tsl::ordered_set<T, Rest...>>
+    : sequence_event_validator<tsl::ordered_set<T, Rest...>, SetCheckFrame<T>> {};
+
+template<typename T, typename Compare, typename Allocator>
+struct event_validator<std::set<T, Compare, Allocator>>
+    : sequence_event_validator<std::set<T, Compare, Allocator>, SetCheckFrame<T>> {};
+
+template<typename T, typename Hash, typename KeyEqual, typename Allocator>
+struct event_validator<std::unordered_set<T, Hash, KeyEqual, Allocator>>
+    : sequence_event_validator<std::unordered_set<T, Hash, KeyEqual, Allocator>, SetCheckFrame<T>> {};
+
+template<typename KT, typename VT, typename... Rest>
+struct event_validator<tsl::ordered_map<KT, VT, Rest...>>
+    : mapping_event_validator<tsl::ordered_map<KT, VT, Rest...>, MapCheckFrame<KT, VT>> {};
+
+template<typename KT, typename VT, typename Compare, typename Allocator>
+struct event_validator<std::map<KT, VT, Compare, Allocator>>
+    : mapping_event_validator<std::map<KT, VT, Compare, Allocator>, MapCheckFrame<KT, VT>> {};
+
+template<typename KT, typename VT, typename Hash, typename KeyEqual, typename Allocator>
+struct event_validator<std::unordered_map<KT, VT, Hash, KeyEqual, Allocator>>
+    : mapping_event_validator<std::unordered_map<KT, VT, Hash, KeyEqual, Allocator>, MapCheckFrame<KT, VT>> {};
+
+template<typename... Types>
+struct event_validator<std::tuple<Types...>>
+    : sequence_event_validator<std::tuple<Types...>, TupleCheckFrame<Types...>> {};
+
+template<typename T>
+struct event_validator<std::optional<T>> {
+  static void check_scalar(const YAML::Mark &mark, const std::string &value) {
+    event_validator<T>::check_scalar(mark, value);
+  }
+
+  static void check_null(const YAML::Mark &) {}
+
+  static std::unique_ptr<EventFrame> check_sequence(const YAML::Mark &mark) {
+    return event_validator<T>::check_sequence(mark);
+  }
+
+  static std::unique_ptr<EventFrame> check_map(const YAML::Mark &mark) {
+    return event_validator<T>::check_map(mark);
+  }
+};
+
+template<map_type T>
+struct event_validator<T> : mapping_event_validator<T, MapTypeCheckFrame<T>> {
+  static void check_scalar(const YAML::Mark &mark, const std::string &value) {
+    Status::bad_conversion(value, map_traits<T>::info, mark).throw_on_error();
+  }
+};
+
+// Validation checks `lazy` values right away, like `validate` does.
+template<typename T>
+struct event_validator<lazy<T>> : event_validator<T> {};
+
+/**
+ * Decodes the first document of `input` into `obj` directly from the parser events, without
+ * building a YAML::Node tree first. Anchors and aliases are not supported.
+ */
+template<typename T>
+inline void decode_stream(std::istream &input, T &obj) {
+  YAML::Parser parser(input);
+  EventDecoder decoder(std::make_unique<ValueFrame<T>>(obj));
+  if (!parser.HandleNextDocument(decoder)) {
+    event_reader<T>::read_null(YAML::Mark::null_mark(), obj);
+  }
+}
+
+/**
+ * Decodes the first document of `input` into `obj` like `decode_stream(input, obj)`, allocating from
+ * `resource` like `decode(node, obj, resource)`.
+ */
+template<typename T>
+inline void decode_stream(std::istream &input, T &obj, std::pmr::memory_resource *resource) {
+  const ResourceScope scope(resource);
+  decode_stream(input, obj);
+}
+
+/**
+ * Checks whether the first document of `input` could be decoded to `T` directly from the parser
+ * events, without building a YAML::Node tree and without keeping any decoded values. Throws the
+ * same exceptions as decoding would.
+ */
+template<typename T>
+inline void check_stream(std::istream &input) {
+  YAML::Parser parser(input);
+  EventDecoder decoder(std::make_unique<ValueCheckFrame<T>>());
+  if (!parser.HandleNextDocument(decoder)) {
+    event_validator<T>::check_null(YAML::Mark::null_mark());
+  }
+}
+
+/**
+ * Feeds the documents of `input` one after another to a `DocumentDecoder` with the root frame made
+ * by `make_frame()`, and calls `f(index, status)` after each of them until it returns false. A syntax
+ * error ends the stream, since the parser can't recover from it.
+ */
+template<typename MakeFrame, typename F>
+inline void handle_stream_documents(std::istream &input, MakeFrame &&make_frame, F &&f) {
+  YAML::Parser parser(input);
+  for (std::size_t index = 0;; ++index) {
+    DocumentDecoder decoder(make_frame());
+    try {
+      if (!parser.HandleNextDocument(decoder)) {
+        return;
+      }
+    } catch (const YAML::Exception &e) {
+      f(index, Status::other(e.msg, e.mark));
+      return;
+    }
+    if (!f(index, Status(decoder.status()))) {
+      return;
+    }
+  }
+}
+
+/**
+ * Decodes every document of a `---` separated stream to a fresh `T`, and calls
+ * `f(index, obj, status)` after each of them until it returns false. `obj` is only valid if `status`
+ * is. Only one document is held in memory at a time.
+ */
+template<typename T, typename F>
+inline void decode_stream_documents(std::istream &input, F &&f) {
+  // Wrapped, so that C arrays can be replaced as well.
+  struct Document {
+      T obj{};
+  };
+  std::optional<Document> document;
+  handle_stream_documents(
+      input,
+      [&] {
+        document.emplace();
+        return std::make_unique<ValueFrame<T>>(document->obj);
+      },
+      [&](std::size_t index, Status &&status) { return f(index, document->obj, std::move(status)); });
+}
+
+/**
+ * Checks every document of a `---` separated stream like `check_stream`, and calls `f(index, result)`
+ * with the `validation_result` of each of them until it returns false.
+ */
+template<typename T, typename F>
+inline void check_stream_documents(std::istream &input, F &&f) {
+  handle_stream_documents(
+      input, [] { return std::make_unique<ValueCheckFrame<T>>(); },
+      [&](std::size_t index, Status &&status) {
+        const bool ok = status.ok();
+        return f(index, validation_result{ok, std::move(status)});
+      });
+}
+
+} // namespace YAVL
+
+#endif // __cpp_exceptions
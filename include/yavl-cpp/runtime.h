@@ -3,14 +3,35 @@
 #include <algorithm>
 #include <any>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
+#include <istream>
+#include <limits>
+#include <memory>
 #include <map>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
 #include <set>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <variant>
 #include <vector>
+#include <yaml-cpp/eventhandler.h>
 #include <yaml-cpp/yaml.h>
 
 #include "tsl/ordered_map.h"
@@ -18,101 +39,1043 @@
 
 namespace YAVL {
 
-using validation_result = std::tuple<bool, std::optional<std::string>>;
-using validation_function = std::function<validation_result(const YAML::Node &node, const std::string type_name)>;
-using type_list = std::vector<std::string>;
-using get_types_function = std::function<type_list()>;
+inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
 
+/**
+ * Returns the index of the field (for map types) or choice (for enum types) of `T` called `key`,
+ * or `YAVL::npos` if there is none. Specializations are generated by yavl-compile.
+ */
+template<typename T>
+std::size_t key_index(std::string_view key);
+
+/**
+ * Describes the fields of a map type. Specializations are generated by yavl-compile and provide
+ * the type's `name`, the field `keys` in declaration order, which fields are `required`, and
+ * `visit(obj, index, f)` to call `f` with the field at `index`, and `visit_type(index, f)` to call `f`
+ * with the `std::type_identity` of that field's type.
+ */
+template<typename T>
+struct map_traits;
+
+template<typename T>
+concept map_type = requires { map_traits<T>::keys; };
+
+/**
+ * A set of fields of the map type `T`, indexed like `map_traits<T>::keys`. The masks of the single
+ * fields are provided by `fields<T>` and can be combined with `|`.
+ */
+template<map_type T>
+class FieldMask {
+  public:
+    static constexpr std::size_t size = map_traits<T>::keys.size();
+
+    constexpr FieldMask() = default;
+
+    static constexpr FieldMask of(std::size_t index) {
+      FieldMask mask;
+      mask.words[index / 64] |= std::uint64_t(1) << (index % 64);
+      return mask;
+    }
+
+    static constexpr FieldMask all() {
+      FieldMask mask;
+      for (std::size_t i = 0; i < size; ++i) {
+        mask.words[i / 64] |= std::uint64_t(1) << (i % 64);
+      }
+      return mask;
+    }
+
+    constexpr bool test(std::size_t index) const {
+      return (words[index / 64] >> (index % 64)) & 1;
+    }
+
+    constexpr FieldMask operator|(const FieldMask &other) const {
+      FieldMask mask;
+      for (std::size_t i = 0; i < words.size(); ++i) {
+        mask.words[i] = words[i] | other.words[i];
+      }
+      return mask;
+    }
+
+    constexpr bool operator==(const FieldMask &other) const = default;
+
+  private:
+    std::array<std::uint64_t, (size + 63) / 64> words{};
+};
+
+/**
+ * Provides a `FieldMask` for each field of the map type `T`, named like the field, e.g.
+ * `YAVL::fields<TopType>::my_int`. Specializations are generated by yavl-compile.
+ */
+template<typename T>
+struct fields;
+
+/**
+ * How `decode()` treats the fields that are left out of its `FieldMask`. Their values are never
+ * stored. With `skip`, they aren't looked at either, and they may be missing even if they are
+ * required. With `validate`, they are decoded to a temporary and checked like all other fields.
+ */
+enum class SkippedFields {
+  skip,
+  validate,
+};
+
+/**
+ * Describes the choices of an enum type. Specializations are generated by yavl-compile and provide
+ * the type's `name` and the `names` of its choices, indexed by their value.
+ */
+template<typename T>
+struct enum_traits;
+
+template<typename T>
+concept enum_type = requires { enum_traits<T>::names; };
+
+/**
+ * Returns the name of `value`, or an empty string view if it is not one of the choices of `T`.
+ */
+template<enum_type T>
+constexpr std::string_view to_string_view(T value) {
+  const auto index = static_cast<std::size_t>(value);
+  return index < enum_traits<T>::names.size() ? enum_traits<T>::names[index] : std::string_view();
+}
+
+/**
+ * Returns the choice of `T` called `name`, or `std::nullopt` if there is none.
+ */
+template<enum_type T>
+inline std::optional<T> from_string_view(std::string_view name) {
+  const std::size_t index = key_index<T>(name);
+  if (index == npos) {
+    return std::nullopt;
+  }
+  return static_cast<T>(index);
+}
+
+/**
+ * Arithmetic types that are decoded with `std::from_chars` instead of the locale-dependent stream
+ * extraction of `YAML::convert`. Character types are left to yaml-cpp, which reads a `char` as a
+ * single character rather than a number.
+ */
+template<typename T>
+concept number_type = (std::integral<T> || std::floating_point<T>) && !std::is_same_v<T, bool>
+    && !std::is_same_v<T, char> && !std::is_same_v<T, wchar_t> && !std::is_same_v<T, char8_t>
+    && !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>;
+
+template<typename T>
+struct is_optional : std::false_type {};
+
+template<typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template<typename T>
+struct is_std_array : std::false_type {};
+
+template<typename T, std::size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+namespace pmr {
+
+// The ordered containers with a polymorphic allocator, like `std::pmr::map` for `std::map`.
+template<typename Key, typename T>
+using ordered_map
+    = tsl::ordered_map<Key, T, std::hash<Key>, std::equal_to<Key>, std::pmr::polymorphic_allocator<std::pair<Key, T>>>;
+
+template<typename Key>
+using ordered_set = tsl::ordered_set<Key, std::hash<Key>, std::equal_to<Key>, std::pmr::polymorphic_allocator<Key>>;
+
+} // namespace pmr
+
+/**
+ * The memory resource for values that are created while decoding without a container to take an
+ * allocator from, i.e. the contents of a `std::optional`. Null means that they use the default
+ * resource. Set with `ResourceScope`.
+ */
+inline thread_local std::pmr::memory_resource *decode_resource = nullptr;
+
+/**
+ * Sets `decode_resource` for the lifetime of the scope.
+ */
+class ResourceScope {
+  public:
+    explicit ResourceScope(std::pmr::memory_resource *resource) : previous(std::exchange(decode_resource, resource)) {}
+
+    ResourceScope(const ResourceScope &) = delete;
+    ResourceScope &operator=(const ResourceScope &) = delete;
+
+    ~ResourceScope() {
+      decode_resource = previous;
+    }
+
+  private:
+    std::pmr::memory_resource *previous;
+};
+
+/**
+ * Whether `lazy` fields are decoded right away instead of on first access. `validate` sets it with
+ * `EagerScope`, so that it still checks the whole document.
+ */
+inline thread_local bool decode_eagerly = false;
+
+/**
+ * Sets `decode_eagerly` for the lifetime of the scope.
+ */
+class EagerScope {
+  public:
+    explicit EagerScope(bool eager) : previous(std::exchange(decode_eagerly, eager)) {}
+
+    EagerScope(const EagerScope &) = delete;
+    EagerScope &operator=(const EagerScope &) = delete;
+
+    ~EagerScope() {
+      decode_eagerly = previous;
+    }
+
+  private:
+    bool previous;
+};
+
+template<typename T>
+concept pmr_type = std::uses_allocator_v<T, std::pmr::polymorphic_allocator<>>;
+
+/**
+ * Returns the item `i` of the array `source`, as an rvalue if `source` is one.
+ */
+template<typename Source>
+inline decltype(auto) array_item(Source &&source, std::size_t i) {
+  if constexpr (std::is_lvalue_reference_v<Source>) {
+    return (source[i]);
+  } else {
+    return std::move(source[i]);
+  }
+}
+
+/**
+ * Constructs a field of a map type like `std::make_obj_using_allocator<T>(allocator)`, but also passes the
+ * allocator on to the items of a `std::array`.
+ */
+template<typename T>
+inline T make_field(const std::pmr::polymorphic_allocator<> &allocator) {
+  if constexpr (is_std_array<T>::value) {
+    return [&]<std::size_t... I>(std::index_sequence<I...>) {
+      return T{((void)I, make_field<typename T::value_type>(allocator))...};
+    }(std::make_index_sequence<std::tuple_size_v<T>>());
+  } else {
+    return std::make_obj_using_allocator<T>(allocator);
+  }
+}
+
+/**
+ * Copies or moves `source` to a new field of a map type like
+ * `std::make_obj_using_allocator<T>(allocator, source)`, but also passes the allocator on to the value
+ * of a `std::optional` and to the items of a `std::array`.
+ */
+template<typename T, typename Source>
+inline T make_field(const std::pmr::polymorphic_allocator<> &allocator, Source &&source) {
+  if constexpr (is_optional<T>::value) {
+    if (!source) {
+      return T();
+    }
+    return T(std::in_place, make_field<typename T::value_type>(allocator, *std::forward<Source>(source)));
+  } else if constexpr (is_std_array<T>::value) {
+    return [&]<std::size_t... I>(std::index_sequence<I...>) {
+      return T{make_field<typename T::value_type>(allocator, array_item(std::forward<Source>(source), I))...};
+    }(std::make_index_sequence<std::tuple_size_v<T>>());
+  } else {
+    return std::make_obj_using_allocator<T>(allocator, std::forward<Source>(source));
+  }
+}
+
+/**
+ * Constructs the items of the C array `target` again with `allocator`, copying or moving them from the C
+ * array `source` if given, since arrays can't be initialized from a value in a constructor.
+ */
+template<typename T, std::size_t N, typename... Source>
+inline void construct_array(T (&target)[N], const std::pmr::polymorphic_allocator<> &allocator, Source &&...source) {
+  for (std::size_t i = 0; i < N; ++i) {
+    if constexpr (std::is_array_v<T>) {
+      construct_array(target[i], allocator, array_item(std::forward<Source>(source), i)...);
+    } else {
+      T item = make_field<T>(allocator, array_item(std::forward<Source>(source), i)...);
+      std::destroy_at(&target[i]);
+      std::construct_at(&target[i], std::move(item));
+    }
+  }
+}
+
+/**
+ * Returns a new `T`, which allocates from `decode_resource` if it takes a polymorphic allocator, or whose
+ * items do if it is a `std::array`.
+ */
+template<typename T>
+inline T make_value() {
+  if constexpr (pmr_type<T> || is_std_array<T>::value) {
+    if (decode_resource) {
+      return make_field<T>(std::pmr::polymorphic_allocator<>(decode_resource));
+    }
+  }
+  return T();
+}
+
+/**
+ * Returns the value of `obj` to decode into. An existing value is kept, so that decoding into it
+ * reuses its memory. Otherwise, it is constructed like `make_value()` first.
+ */
+template<typename T>
+inline T &ensure_value(std::optional<T> &obj) {
+  if (obj) {
+    return *obj;
+  }
+  if constexpr (pmr_type<T> || is_std_array<T>::value) {
+    return obj.emplace(make_value<T>());
+  } else {
+    return obj.emplace();
+  }
+}
+
+/**
+ * The names that a `Status` refers to a type by: the name of the type and the keys of its fields
+ * (or the choices of an enum type). yavl-compile generates one as `info` in the traits of every map
+ * and enum type, `YAVL::Schema` keeps one in each of its types.
+ */
+struct TypeInfo {
+    std::string_view name;
+    std::span<const std::string_view> keys;
+};
+
+/**
+ * The result of decoding a value. A default-constructed status means success. On failure, it
+ * records the kind of error, the type and the index of the key involved, and the position of the
+ * error. The offending value is copied, so the status doesn't keep the document alive. The
+ * message is only rendered when `message()` is called.
+ *
+ * The type is referred to by its `TypeInfo`, which is static in generated code. A status that
+ * names a type must not outlive the code or the `YAVL::Schema` that produced it, e.g. a spec
+ * library that is unloaded with `dlclose`. That is why a `SymbolTable` only hands out rendered
+ * messages.
+ */
+class [[nodiscard]] Status {
+  public:
+    enum class Error : std::uint8_t {
+      none,
+      bad_conversion,
+      missing_key,
+      superfluous_key,
+      duplicate_set_item,
+      duplicate_map_item,
+      invalid_sequence_length,
+      unsupported_alias,
+      other,
+    };
+
+    Status() = default;
+
+    static Status bad_conversion(const YAML::Mark &mark) {
+      return Status(Error::bad_conversion, mark);
+    }
+
+    static Status bad_conversion(const YAML::Node &node, const TypeInfo &type) {
+      if (node.IsScalar()) {
+        return bad_conversion(node.Scalar(), type, node.Mark());
+      }
+      if (node.IsNull()) {
+        return bad_conversion("null", type, node.Mark());
+      }
+      return bad_conversion(node.Mark());
+    }
+
+    static Status bad_conversion(std::string_view value, const TypeInfo &type, const YAML::Mark &mark) {
+      Status status(Error::bad_conversion, mark);
+      status.type_info = &type;
+      status.value = value;
+      return status;
+    }
+
+    static Status missing_key(const TypeInfo &type, std::size_t key, const YAML::Mark &mark) {
+      Status status(Error::missing_key, mark);
+      status.type_info = &type;
+      status.index = key;
+      return status;
+    }
+
+    static Status superfluous_key(const TypeInfo &type, std::string_view key, const YAML::Mark &mark) {
+      Status status(Error::superfluous_key, mark);
+      status.type_info = &type;
+      status.value = key;
+      return status;
+    }
+
+    static Status duplicate_set_item(const YAML::Mark &mark) {
+      return Status(Error::duplicate_set_item, mark);
+    }
+
+    static Status duplicate_map_item(const YAML::Mark &mark) {
+      return Status(Error::duplicate_map_item, mark);
+    }
+
+    static Status invalid_sequence_length(std::size_t expected, std::size_t got, const YAML::Mark &mark) {
+      Status status(Error::invalid_sequence_length, mark);
+      status.index = expected;
+      status.got = got;
+      return status;
+    }
+
+    static Status unsupported_alias(const YAML::Mark &mark) {
+      return Status(Error::unsupported_alias, mark);
+    }
+
+    // An error that is only known by its message, e.g. one reported by the yaml-cpp parser.
+    static Status other(std::string message, const YAML::Mark &mark = YAML::Mark::null_mark()) {
+      Status status(Error::other, mark);
+      status.value = std::move(message);
+      return status;
+    }
+
+    bool ok() const {
+      return error_kind == Error::none;
+    }
+
+    explicit operator bool() const {
+      return ok();
+    }
+
+    Error error() const {
+      return error_kind;
+    }
+
+    const YAML::Mark &mark() const {
+      return error_mark;
+    }
+
+    // The type of a bad conversion, missing key or superfluous key, or null.
+    const TypeInfo *type() const {
+      return type_info;
+    }
+
+    // The index of the missing key in the keys of `type()`.
+    std::size_t key() const {
+      return index;
+    }
+
+    // Sets the position of the error, unless it is already known.
+    Status &locate(const YAML::Mark &mark) {
+      if (error_mark.is_null()) {
+        error_mark = mark;
+      }
+      return *this;
+    }
+
+    // The message of the error, without the position. Empty on success.
+    std::string description() const {
+      std::string result;
+      switch (error_kind) {
+        case Error::none:
+          break;
+        case Error::bad_conversion:
+          if (!type_info) {
+            result = YAML::ErrorMsg::BAD_CONVERSION;
+          } else {
+            result.append("Bad conversion from value \"").append(value);
+            result.append("\" to type \"").append(type_info->name).append("\"");
+          }
+          break;
+        case Error::missing_key:
+          result.append("Missing key \"").append(type_info->keys[index]);
+          result.append("\" during conversion to type \"").append(type_info->name).append("\"");
+          break;
+        case Error::superfluous_key:
+          result.append("Superfluous key \"").append(value);
+          result.append("\" during conversion to type \"").append(type_info->name).append("\"");
+          break;
+        case Error::duplicate_set_item:
+          result = "Duplicate key in set";
+          break;
+        case Error::duplicate_map_item:
+          result = "Duplicate key in map";
+          break;
+        case Error::invalid_sequence_length:
+          result.append("Invalid sequence length \"").append(std::to_string(got));
+          result.append("\", expected \"").append(std::to_string(index)).append("\"");
+          break;
+        case Error::unsupported_alias:
+          result = "Aliases are not supported when decoding from a stream";
+          break;
+        case Error::other:
+          result = value;
+          break;
+      }
+      return result;
+    }
+
+    // The message of the error in the same format as the `what()` of a yaml-cpp exception.
+    std::string message() const {
+      if (error_mark.is_null()) {
+        return description();
+      }
+      return "yaml-cpp: error at line " + std::to_string(error_mark.line + 1) + ", column "
+          + std::to_string(error_mark.column + 1) + ": " + description();
+    }
+
+    // Throws the exception that describes the error. Does nothing on success.
+    void throw_on_error() const;
+
+  private:
+    Status(Error error_kind, const YAML::Mark &mark) : error_kind(error_kind), error_mark(mark) {}
+
+    Error error_kind = Error::none;
+    YAML::Mark error_mark = YAML::Mark::null_mark();
+    const TypeInfo *type_info = nullptr;
+    // The index of the missing key, or the expected length of a sequence.
+    std::size_t index = 0;
+    std::size_t got = 0;
+    // The offending value or key, or the message of an `Error::other`.
+    std::string value;
+};
+
+/**
+ * The result of a validation. `error` describes why it failed, its message is only rendered when
+ * `error.message()` is called.
+ */
+struct validation_result {
+    bool ok;
+    Status error;
+};
+
+inline constexpr std::uint32_t symbol_table_version = 3;
+
+/**
+ * A document that is passed to a spec library as `length` bytes of YAML at `data`.
+ */
+struct DocumentBytes {
+    const char *data;
+    std::size_t length;
+};
+
+/**
+ * A stream that is passed to a spec library piece by piece. `read` copies up to `size` bytes to
+ * `buffer` and returns how many it copied, or 0 at the end of the stream.
+ */
+struct DocumentReader {
+    std::size_t (*read)(void *context, char *buffer, std::size_t size);
+    void *context;
+};
+
+/**
+ * The result of a validation by a spec library. If `ok` is false, `message` is the rendered error
+ * message as a null-terminated string, which is owned by the library. It stays valid until the next
+ * call into the library from the same thread, or until a callback that receives it returns.
+ */
+struct ValidationReport {
+    bool ok;
+    const char *message;
+};
+
+/**
+ * The entry points of a spec library, as returned by its `get_symbols()`. The table only holds
+ * plain function pointers, and all of their parameters are pointers, sizes and the structs above,
+ * so no C++ objects and no statuses that refer to the library cross its boundary. Documents are
+ * passed as bytes and parsed by the library, streams are pulled through a `DocumentReader`.
+ *
+ * Types are identified by their ID, which is the index of the type in the spec and in
+ * `type_names`. `get_type_id` returns `YAVL::npos` for unknown names. `validate_many` validates
+ * `count` documents against the same type in a single call. `validate_stream_documents_by_id` validates
+ * every document of a stream and passes each report to `callback` along with `context`, until it
+ * returns false. Syntax errors are reported like validation errors.
+ *
+ * Callers have to check `version` against `symbol_table_version` before using the table, since the
+ * layout of the table and of the types passed through it may change.
+ */
 struct SymbolTable {
-    validation_function validate_simple;
-    get_types_function get_types;
+    std::uint32_t version;
+    std::size_t num_types;
+    const char *const *type_names;
+    std::size_t (*get_type_id)(const char *type_name, std::size_t length);
+    void (*validate_by_id)(DocumentBytes document, std::size_t type_id, ValidationReport *report);
+    void (*validate_many)(const DocumentBytes *documents, std::size_t count, std::size_t type_id, ValidationReport *reports);
+    void (*validate_stream_by_id)(DocumentReader input, std::size_t type_id, ValidationReport *report);
+    void (*validate_stream_documents_by_id)(DocumentReader input, std::size_t type_id,
+        bool (*callback)(void *context, std::size_t index, const ValidationReport *report), void *context);
 };
 
-class BadConversionException : public YAML::RepresentationException {
+/**
+ * Reads a `DocumentReader` through a `std::istream`, see `SymbolTable`.
+ */
+class DocumentReaderBuffer : public std::streambuf {
   public:
-    explicit BadConversionException(const YAML::Node &node, const std::string &type_name)
-        : YAML::RepresentationException(YAML::Mark::null_mark(),
-            std::string("Bad conversion from value \"") + node.as<std::string>() + "\" to type \"" + type_name + "\"") {
+    explicit DocumentReaderBuffer(DocumentReader reader) : reader(reader) {}
+
+  protected:
+    int_type underflow() override {
+      const std::size_t size = reader.read(reader.context, buffer.data(), buffer.size());
+      if (size == 0) {
+        return traits_type::eof();
+      }
+      setg(buffer.data(), buffer.data(), buffer.data() + size);
+      return traits_type::to_int_type(buffer[0]);
     }
+
+  private:
+    DocumentReader reader;
+    std::array<char, 65536> buffer;
 };
 
-class MissingKeyException : public YAML::RepresentationException {
+/**
+ * Reads `DocumentBytes` through a `std::istream` without copying them.
+ */
+class DocumentBytesBuffer : public std::streambuf {
   public:
-    explicit MissingKeyException(const std::string &type_name, const std::string &key_name)
-        : YAML::RepresentationException(YAML::Mark::null_mark(),
-            std::string("Missing key \"") + key_name + "\" during conversion to type \"" + type_name + "\"") {}
+    explicit DocumentBytesBuffer(DocumentBytes document) {
+      // The get area is never written to, so the bytes may be read-only.
+      char *begin = const_cast<char *>(document.data);
+      setg(begin, begin, begin + document.length);
+    }
 };
 
-class SuperfluousKeyException : public YAML::RepresentationException {
+/**
+ * Renders `result` into the report of a `SymbolTable` call. The message is stored in `message`,
+ * which has to outlive the report.
+ */
+inline ValidationReport make_report(const validation_result &result, std::string &message) {
+  if (result.ok) {
+    return {true, nullptr};
+  }
+  message = result.error.message();
+  return {false, message.c_str()};
+}
+
+/**
+ * Returns a `DocumentReader` that reads from `input`, which has to outlive it.
+ */
+inline DocumentReader read_from(std::istream &input) {
+  return {[](void *context, char *buffer, std::size_t size) -> std::size_t {
+            auto &input = *static_cast<std::istream *>(context);
+            input.read(buffer, static_cast<std::streamsize>(size));
+            return static_cast<std::size_t>(input.gcount());
+          },
+      &input};
+}
+
+/**
+ * Base class of the exceptions thrown by yavl-cpp. It carries the status of the failed conversion.
+ * The message is rendered when the exception is created and stored in `msg`, like for every other
+ * yaml-cpp exception, so `what()` doesn't depend on the status anymore. Exceptions that are created
+ * from the names of a type instead of a status carry an `Error::other` status with their message.
+ */
+class DecodeException : public YAML::RepresentationException {
   public:
-    explicit SuperfluousKeyException(const std::string &type_name, const std::string &key_name)
-        : YAML::RepresentationException(YAML::Mark::null_mark(),
-            std::string("Superfluous key \"") + key_name + "\" during conversion to type \"" + type_name + "\"") {}
+    explicit DecodeException(Status status)
+        : YAML::RepresentationException(status.mark(), status.description()), decode_status(std::move(status)) {}
+
+    const Status &status() const {
+      return decode_status;
+    }
+
+  private:
+    Status decode_status;
+};
+
+class BadConversionException : public DecodeException {
+  public:
+    using DecodeException::DecodeException;
+
+    explicit BadConversionException(const YAML::Node &node, std::string_view type_name)
+        : DecodeException(Status::other(Status::bad_conversion(node, TypeInfo{type_name, {}}).description(), node.Mark())) {}
+};
+
+class MissingKeyException : public DecodeException {
+  public:
+    using DecodeException::DecodeException;
+
+    explicit MissingKeyException(
+        std::string_view type_name, std::string_view key_name, const YAML::Mark &mark = YAML::Mark::null_mark())
+        : DecodeException(Status::other(
+            Status::missing_key(TypeInfo{type_name, {&key_name, 1}}, 0, mark).description(), mark)) {}
 };
 
-class DuplicateSetItemException : public YAML::RepresentationException {
+class SuperfluousKeyException : public DecodeException {
   public:
-    explicit DuplicateSetItemException()
-        : YAML::RepresentationException(YAML::Mark::null_mark(), std::string("Duplicate key in set")) {}
+    using DecodeException::DecodeException;
+
+    explicit SuperfluousKeyException(
+        std::string_view type_name, const YAML::Node &key, const YAML::Mark &mark = YAML::Mark::null_mark())
+        : DecodeException(Status::other(
+            Status::superfluous_key(TypeInfo{type_name, {}}, key.Scalar(), mark).description(), mark)) {}
 };
 
-class DuplicateMapItemException : public YAML::RepresentationException {
+class DuplicateSetItemException : public DecodeException {
   public:
-    explicit DuplicateMapItemException()
-        : YAML::RepresentationException(YAML::Mark::null_mark(), std::string("Duplicate key in map")) {}
+    using DecodeException::DecodeException;
+
+    explicit DuplicateSetItemException(const YAML::Mark &mark = YAML::Mark::null_mark())
+        : DecodeException(Status::duplicate_set_item(mark)) {}
 };
 
-class InvalidSequenceLengthException : public YAML::RepresentationException {
+class DuplicateMapItemException : public DecodeException {
   public:
-    explicit InvalidSequenceLengthException(std::size_t expected, std::size_t got)
-        : YAML::RepresentationException(YAML::Mark::null_mark(),
-            std::string("Invalid sequence length \"" + std::to_string(got) + "\", expected \""
-                + std::to_string(expected) + "\"")) {}
+    using DecodeException::DecodeException;
+
+    explicit DuplicateMapItemException(const YAML::Mark &mark = YAML::Mark::null_mark())
+        : DecodeException(Status::duplicate_map_item(mark)) {}
 };
 
+class InvalidSequenceLengthException : public DecodeException {
+  public:
+    using DecodeException::DecodeException;
+
+    explicit InvalidSequenceLengthException(
+        std::size_t expected, std::size_t got, const YAML::Mark &mark = YAML::Mark::null_mark())
+        : DecodeException(Status::invalid_sequence_length(expected, got, mark)) {}
+};
+
+class UnsupportedAliasException : public DecodeException {
+  public:
+    using DecodeException::DecodeException;
+
+    explicit UnsupportedAliasException(const YAML::Mark &mark = YAML::Mark::null_mark())
+        : DecodeException(Status::unsupported_alias(mark)) {}
+};
+
+inline void Status::throw_on_error() const {
+#ifdef __cpp_exceptions
+  switch (error_kind) {
+    case Error::none:
+      break;
+    case Error::bad_conversion:
+      if (!type_info) {
+        throw YAML::BadConversion(error_mark);
+      }
+      throw BadConversionException(*this);
+    case Error::missing_key:
+      throw MissingKeyException(*this);
+    case Error::superfluous_key:
+      throw SuperfluousKeyException(*this);
+    case Error::duplicate_set_item:
+      throw DuplicateSetItemException(*this);
+    case Error::duplicate_map_item:
+      throw DuplicateMapItemException(*this);
+    case Error::invalid_sequence_length:
+      throw InvalidSequenceLengthException(*this);
+    case Error::unsupported_alias:
+      throw UnsupportedAliasException(*this);
+    case Error::other:
+      throw DecodeException(*this);
+  }
+#else
+  if (!ok()) {
+    std::abort();
+  }
+#endif
+}
+
+// Decoding from parser events relies on exceptions, since the yaml-cpp parser reports its errors
+// that way as well.
+#ifdef __cpp_exceptions
+
+/**
+ * Receives the parser events for the children of one sequence or mapping. Frames are created by
+ * `event_reader<T>` when a container starts, and are kept on the stack of an `EventDecoder` until
+ * the matching end event. Starting a nested container returns the frame for that child.
+ */
+class EventFrame {
+  public:
+    virtual ~EventFrame() = default;
+    virtual void on_scalar(const YAML::Mark &mark, const std::string &value) = 0;
+    virtual void on_null(const YAML::Mark &mark) = 0;
+    virtual std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &mark) = 0;
+    virtual std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &mark) = 0;
+    // Called after a child started by on_sequence_start() or on_map_start() has ended.
+    virtual void on_child_end() {}
+    // Called when the container of this frame ends.
+    virtual void on_end() {}
+};
+
+/**
+ * Ignores a value and all of its children.
+ */
+class SkipFrame : public EventFrame {
+  public:
+    void on_scalar(const YAML::Mark &, const std::string &) override {}
+    void on_null(const YAML::Mark &) override {}
+    std::unique_ptr<EventFrame> on_sequence_start(const YAML::Mark &) override {
+      return std::make_unique<SkipFrame>();
+    }
+    std::unique_ptr<EventFrame> on_map_start(const YAML::Mark &) override {
+      return std::make_unique<SkipFrame>();
+    }
+};
+
+/**
+ * Forwards the events of a yaml-cpp parser to a stack of frames. Only the frames of the currently
+ * open containers are alive, so no node tree is built and the memory usage is bounded by the
+ * nesting depth of the document.
+ */
+class EventDecoder : public YAML::EventHandler {
+  public:
+    explicit EventDecoder(std::unique_ptr<EventFrame> root) {
+      frames.push_back(std::move(root));
+    }
+
+    void OnDocumentStart(const YAML::Mark &) override {}
+    void OnDocumentEnd() override {}
+
+    void OnNull(const YAML::Mark &mark, YAML::anchor_t) override {
+      frames.back()->on_null(mark);
+    }
+
+    void OnAlias(const YAML::Mark &mark, YAML::anchor_t) override {
+      throw UnsupportedAliasException(mark);
+    }
+
+    void OnScalar(const YAML::Mark &mark, const std::string &, YAML::anchor_t, const std::string &value) override {
+      frames.back()->on_scalar(mark, value);
+    }
+
+    void OnSequenceStart(const YAML::Mark &mark, const std::string &, YAML::anchor_t, YAML::EmitterStyle::value) override {
+      frames.push_back(frames.back()->on_sequence_start(mark));
+    }
+
+    void OnSequenceEnd() override {
+      end_frame();
+    }
+
+    void OnMapStart(const YAML::Mark &mark, const std::string &, YAML::anchor_t, YAML::EmitterStyle::value) override {
+      frames.push_back(frames.back()->on_map_start(mark));
+    }
+
+    void OnMapEnd() override {
+      end_frame();
+    }
+
+  private:
+    void end_frame() {
+      frames.back()->on_end();
+      frames.pop_back();
+      frames.back()->on_child_end();
+    }
+
+    std::vector<std::unique_ptr<EventFrame>> frames;
+};
+
+/**
+ * Decodes a single document of a stream like `EventDecoder`, but records the first error as its
+ * `status()` instead of throwing it. The remaining events of the document are ignored, so the parser
+ * can go on with the next document.
+ */
+class DocumentDecoder : public YAML::EventHandler {
+  public:
+    explicit DocumentDecoder(std::unique_ptr<EventFrame> root) : decoder(std::move(root)) {}
+
+    void OnDocumentStart(const YAML::Mark &) override {}
+    void OnDocumentEnd() override {}
+
+    void OnNull(const YAML::Mark &mark, YAML::anchor_t anchor) override {
+      forward([&] { decoder.OnNull(mark, anchor); });
+    }
+
+    void OnAlias(const YAML::Mark &mark, YAML::anchor_t anchor) override {
+      forward([&] { decoder.OnAlias(mark, anchor); });
+    }
+
+    void OnScalar(const YAML::Mark &mark, const std::string &tag, YAML::anchor_t anchor,
+        const std::string &value) override {
+      forward([&] { decoder.OnScalar(mark, tag, anchor, value); });
+    }
+
+    void OnSequenceStart(const YAML::Mark &mark, const std::string &tag, YAML::anchor_t anchor,
+        YAML::EmitterStyle::value style) override {
+      forward([&] { decoder.OnSequenceStart(mark, tag, anchor, style); });
+    }
+
+    void OnSequenceEnd() override {
+      forward([&] { decoder.OnSequenceEnd(); });
+    }
+
+    void OnMapStart(const YAML::Mark &mark, const std::string &tag, YAML::anchor_t anchor,
+        YAML::EmitterStyle::value style) override {
+      forward([&] { decoder.OnMapStart(mark, tag, anchor, style); });
+    }
+
+    void OnMapEnd() override {
+      forward([&] { decoder.OnMapEnd(); });
+    }
+
+    const Status &status() const {
+      return error;
+    }
+
+  private:
+    template<typename F>
+    void forward(F &&f) {
+      if (!error.ok()) {
+        return;
+      }
+      try {
+        f();
+      } catch (const DecodeException &e) {
+        error = e.status();
+      } catch (const YAML::Exception &e) {
+        error = Status::other(e.msg, e.mark);
+      }
+    }
+
+    EventDecoder decoder;
+    Status error;
+};
+
+#endif // __cpp_exceptions
+
 } // namespace YAVL
 
+namespace YAVL {
+
+/**
+ * Decodes a YAML node to type `T` without throwing. Specializations for the containers
+ * supported by yavl-cpp live in convert.h, the ones for map and enum types are generated by
+ * yavl-compile. The generic version uses `YAML::convert<T>`.
+ */
 template<typename T>
-inline void operator>>(const YAML::Node &node, T &obj);
+struct decoder;
 
 template<typename T>
-inline void operator>>(const YAML::Node &node, std::vector<T> &obj);
+inline Status decode(const YAML::Node &node, T &obj) {
+  if constexpr (!is_optional<T>::value) {
+    if (!node.IsDefined()) {
+      return Status::bad_conversion(YAML::Mark::null_mark());
+    }
+  }
+  return decoder<T>::decode(node, obj);
+}
 
-template<typename T, std::size_t N>
-inline void operator>>(const YAML::Node &node, std::array<T, N> &obj);
+/**
+ * Decodes `node` into `obj`, allocating the values that can't take the allocator of their container
+ * from `resource`. `obj` itself should be constructed with `resource`, so that a whole document can be
+ * decoded into an arena:
+ *
+ *     std::pmr::monotonic_buffer_resource arena;
+ *     TopType top(&arena);
+ *     YAVL::Status status = YAVL::decode(node, top, &arena);
+ */
+template<typename T>
+inline Status decode(const YAML::Node &node, T &obj, std::pmr::memory_resource *resource) {
+  const ResourceScope scope(resource);
+  return decode(node, obj);
+}
 
-template<typename T, std::size_t N>
-inline void operator>>(const YAML::Node &node, T (&obj)[N]);
+} // namespace YAVL
 
+/**
+ * Decodes `node` into `obj`, throwing the exception that corresponds to the status of
+ * `YAVL::decode` on failure.
+ */
 template<typename T>
-inline void operator>>(const YAML::Node &node, tsl::ordered_set<T> &obj);
+inline void operator>>(const YAML::Node &node, T &obj);
 
 template<typename T>
-inline void operator>>(const YAML::Node &node, std::set<T> &obj);
+inline YAVL::validation_result validate(const YAML::Node &node) {
+  YAVL::Status status;
+  const YAVL::EagerScope eager(true);
+  if constexpr (YAVL::pmr_type<T>) {
+    // The decoded value is discarded right away, so it is allocated from an arena that is released
+    // as a whole instead of freeing each of its allocations.
+    std::array<std::byte, 4096> buffer;
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    T tmp = std::make_obj_using_allocator<T>(std::pmr::polymorphic_allocator<>(&arena));
+    status = YAVL::decode(node, tmp, &arena);
+  } else {
+    T tmp;
+    status = YAVL::decode(node, tmp);
+  }
+  // Braced initializers are evaluated in order, so `ok` is read before the status is moved.
+  return {status.ok(), std::move(status)};
+}
 
+/**
+ * Validates `count` documents against `T`, writing the result for `nodes[i]` to `results[i]`.
+ */
 template<typename T>
-inline void operator>>(const YAML::Node &node, std::unordered_set<T> &obj);
+inline void validate_many(const YAML::Node *nodes, std::size_t count, YAVL::validation_result *results) {
+  for (std::size_t i = 0; i < count; ++i) {
+    results[i] = validate<T>(nodes[i]);
+  }
+}
 
-template<typename KT, typename VT>
-inline void operator>>(const YAML::Node &node, tsl::ordered_map<KT, VT> &obj);
+#ifdef __cpp_exceptions
 
-template<typename KT, typename VT>
-inline void operator>>(const YAML::Node &node, std::map<KT, VT> &obj);
+namespace YAVL {
 
-template<typename KT, typename VT>
-inline void operator>>(const YAML::Node &node, std::unordered_map<KT, VT> &obj);
+/**
+ * Decodes a value of type `T` from parser events. `read_scalar()` and `read_null()` decode a value
+ * directly, `read_sequence()` and `read_map()` return the frame that receives the children.
+ * The generic version decodes scalars as a single detached node with `YAVL::decode`.
+ */
+template<typename T>
+struct event_reader;
 
-template<class... Types>
-inline void operator>>(const YAML::Node &node, std::tuple<Types...> &obj);
+template<typename T>
+inline void decode_stream(std::istream &input, T &obj);
 
 template<typename T>
-inline void operator>>(const YAML::Node &node, std::optional<T> &obj);
+inline void check_stream(std::istream &input);
+
+template<typename T, typename F>
+inline void decode_stream_documents(std::istream &input, F &&f);
+
+template<typename T, typename F>
+inline void check_stream_documents(std::istream &input, F &&f);
+
+} // namespace YAVL
 
 template<typename T>
-inline std::tuple<bool, std::optional<std::string>> validate(const YAML::Node &node) {
+inline YAVL::validation_result validate_stream(std::istream &input) {
   try {
-    T tmp;
-    node >> tmp;
-  } catch (const YAML::Exception &e) { return std::make_tuple(false, e.what()); }
-  return std::make_tuple(true, std::nullopt);
+    YAVL::check_stream<T>(input);
+  } catch (const YAVL::DecodeException &e) {
+    return {false, e.status()};
+  } catch (const YAML::Exception &e) {
+    return {false, YAVL::Status::other(e.msg, e.mark)};
+  }
+  return {true, YAVL::Status()};
+}
+
+namespace YAVL {
+
+/**
+ * Parses a document that was passed to a `SymbolTable` into `node`. A syntax error is reported like
+ * by `validate_stream`.
+ */
+inline Status parse_document(DocumentBytes document, YAML::Node &node) {
+  try {
+    DocumentBytesBuffer buffer(document);
+    std::istream input(&buffer);
+    node = YAML::Load(input);
+  } catch (const YAML::Exception &e) {
+    return Status::other(e.msg, e.mark);
+  }
+  return Status();
+}
+
+/**
+ * Parses `document` and returns the result of `validate(node)`, or the syntax error.
+ */
+template<typename F>
+inline validation_result validate_document(DocumentBytes document, F &&validate) {
+  YAML::Node node;
+  if (Status status = parse_document(document, node); !status) {
+    return {false, std::move(status)};
+  }
+  return validate(node);
+}
+
+} // namespace YAVL
+
+/**
+ * Validates every document of a `---` separated stream against `T`, like `validate_stream`, and calls
+ * `f(index, result)` with the `validation_result` of each. Only one document is processed at a time,
+ * so the memory usage doesn't grow with the length of the stream. Stops when `f` returns false, and
+ * after a syntax error, which is reported for the document it occurred in.
+ */
+template<typename T, typename F>
+inline void validate_stream_documents(std::istream &input, F &&f) {
+  YAVL::check_stream_documents<T>(input, std::forward<F>(f));
 }
+
+#endif // __cpp_exceptions
@@ -0,0 +1,586 @@
+#pragma once
+
+#include "yavl-cpp/convert.h"
+
+namespace YAVL {
+
+/**
+ * A canonical form of a decoded value, used to find duplicate set items and map keys without
+ * decoding into the actual C++ type. Two keys are equal exactly if the decoded values are.
+ */
+struct SchemaKey {
+    std::variant<std::monostate, std::int64_t, std::uint64_t, long double, std::string, std::vector<SchemaKey>> value;
+
+    bool operator<(const SchemaKey &other) const {
+      return value < other.value;
+    }
+};
+
+/**
+ * Decodes `node` into a `T` to check it and stores the canonical form of the value in `key`, unless
+ * it is null. Used for all scalar types of a schema, so that they are checked by the same decoders
+ * as in generated code.
+ */
+template<typename T>
+inline Status check_value(const YAML::Node &node, SchemaKey *key) {
+  if constexpr (std::is_same_v<T, std::string>) {
+    // Only copy the scalar if it is needed as a key.
+    if (!key && node.IsDefined()) {
+      return node.IsScalar() || node.IsNull() ? Status() : Status::bad_conversion(node.Mark());
+    }
+  }
+  T obj;
+  Status status = decode(node, obj);
+  if (!status || !key) {
+    return status;
+  }
+  if constexpr (std::is_same_v<T, std::string>) {
+    key->value = std::move(obj);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    key->value = static_cast<long double>(obj);
+  } else if constexpr (std::is_signed_v<T>) {
+    key->value = static_cast<std::int64_t>(obj);
+  } else if constexpr (std::is_unsigned_v<T>) {
+    key->value = static_cast<std::uint64_t>(obj);
+  }
+  return status;
+}
+
+/**
+ * A type of a `Schema`. Container types refer to the types of their items as `children`, so the
+ * types of a schema form a tree (or a graph, for recursive map types).
+ */
+struct SchemaType {
+    enum class Kind {
+      value,
+      optional,
+      sequence,
+      fixed_sequence,
+      set,
+      map,
+      tuple,
+      map_type,
+      enum_type,
+    };
+
+    Kind kind = Kind::value;
+    // Checks a scalar type, see `check_value`.
+    Status (*check)(const YAML::Node &node, SchemaKey *key) = nullptr;
+    // The item type, the key and value types of a map, the item types of a tuple, or the field types
+    // of a map type.
+    std::vector<const SchemaType *> children;
+    // The length of a fixed sequence.
+    std::size_t length = 0;
+    // Whether the type can be used for set items and map keys, i.e. whether it is comparable in C++.
+    bool comparable = true;
+    // The name, fields or choices of a map or enum type. `key_indices` refers to the strings in `keys`.
+    std::string name;
+    std::vector<std::string> keys;
+    std::vector<bool> required;
+    std::unordered_map<std::string_view, std::size_t> key_indices;
+    // The names of the type for statuses. `key_names` refers to the strings in `keys` as well.
+    std::vector<std::string_view> key_names;
+    TypeInfo info;
+};
+
+/**
+ * A spec that is loaded at runtime, so that documents can be validated without compiling any code.
+ * `load()` compiles the types of the spec into a tree of `SchemaType`, which `validate_by_id()`
+ * walks along the document. It reports the same errors as the code generated by yavl-compile.
+ *
+ * Statuses refer to the `TypeInfo` of the schema's types, so they must not outlive it. The extra
+ * includes and the custom code generator of a spec are ignored.
+ */
+class Schema {
+  public:
+    // Compiles `spec`. Fails if it isn't a spec, or if it uses types that are unknown or can't be
+    // validated at runtime.
+    Status load(const YAML::Node &spec);
+
+    // The names of the types in the spec, indexed by their ID.
+    std::span<const std::string> get_types() const {
+      return type_names;
+    }
+
+    std::size_t get_type_id(std::string_view type_name) const {
+      const auto it = declarations.find(std::string(type_name));
+      return it == declarations.end() ? npos : it->second.id;
+    }
+
+    validation_result validate_by_id(const YAML::Node &node, std::size_t type_id) const {
+      if (type_id >= types.size()) {
+        return {false, Status::other("Unknown type")};
+      }
+      Status status = check(*types[type_id], node);
+      return {status.ok(), std::move(status)};
+    }
+
+    validation_result validate_simple(const YAML::Node &node, std::string_view type_name) const {
+      return validate_by_id(node, get_type_id(type_name));
+    }
+
+    // Checks `node` against `type`, writing the canonical form of its value to `key` if it isn't null.
+    static Status check(const SchemaType &type, const YAML::Node &node, SchemaKey *key = nullptr);
+
+  private:
+    // A C++ type as written in a spec, e.g. `std::map<std::string, int[2]>`.
+    struct TypeExpression {
+        std::string name;
+        std::vector<TypeExpression> arguments;
+        std::vector<std::size_t> extents;
+    };
+
+    struct Declaration {
+        std::size_t id;
+        const SchemaType *type = nullptr;
+        // The aliased type, which is only resolved when the alias is first used.
+        YAML::Node alias;
+        bool resolving = false;
+    };
+
+    static bool parse(std::string_view text, std::size_t &pos, TypeExpression &expression);
+    Status resolve(const YAML::Node &node, const SchemaType *&type);
+    Status resolve(const TypeExpression &expression, const YAML::Mark &mark, const SchemaType *&type);
+    Status resolve(const std::string &name, Declaration &declaration);
+
+    // Names `SpecType` in the errors of `load()`, with the keys in the order of spec_spec.yaml.
+    static constexpr std::array<std::string_view, 3> spec_type_keys = {"ExtraIncludes", "CustomCodeGenerator", "Types"};
+    static constexpr TypeInfo spec_type_info = {"SpecType", spec_type_keys};
+
+    SchemaType *add(SchemaType type) {
+      owned_types.push_back(std::make_unique<SchemaType>(std::move(type)));
+      return owned_types.back().get();
+    }
+
+    std::vector<std::string> type_names;
+    std::vector<const SchemaType *> types;
+    std::unordered_map<std::string, Declaration> declarations;
+    std::vector<std::unique_ptr<SchemaType>> owned_types;
+};
+
+/**
+ * The scalar types a schema knows, by the names they can be written as in a spec.
+ */
+inline const std::unordered_map<std::string_view, Status (*)(const YAML::Node &, SchemaKey *)> &schema_value_types() {
+  static const std::unordered_map<std::string_view, Status (*)(const YAML::Node &, SchemaKey *)> value_types = {
+      {"bool", check_value<bool>},
+      {"char", check_value<char>},
+      {"signed char", check_value<signed char>},
+      {"unsigned char", check_value<unsigned char>},
+      {"short", check_value<short>},
+      {"short int", check_value<short>},
+      {"unsigned short", check_value<unsigned short>},
+      {"unsigned short int", check_value<unsigned short>},
+      {"int", check_value<int>},
+      {"signed", check_value<int>},
+      {"signed int", check_value<int>},
+      {"unsigned", check_value<unsigned>},
+      {"unsigned int", check_value<unsigned>},
+      {"long", check_value<long>},
+      {"long int", check_value<long>},
+      {"unsigned long", check_value<unsigned long>},
+      {"unsigned long int", check_value<unsigned long>},
+      {"long long", check_value<long long>},
+      {"long long int", check_value<long long>},
+      {"unsigned long long", check_value<unsigned long long>},
+      {"unsigned long long int", check_value<unsigned long long>},
+      {"float", check_value<float>},
+      {"double", check_value<double>},
+      {"long double", check_value<long double>},
+      {"int8_t", check_value<std::int8_t>},
+      {"int16_t", check_value<std::int16_t>},
+      {"int32_t", check_value<std::int32_t>},
+      {"int64_t", check_value<std::int64_t>},
+      {"uint8_t", check_value<std::uint8_t>},
+      {"uint16_t", check_value<std::uint16_t>},
+      {"uint32_t", check_value<std::uint32_t>},
+      {"uint64_t", check_value<std::uint64_t>},
+      {"size_t", check_value<std::size_t>},
+      {"ptrdiff_t", check_value<std::ptrdiff_t>},
+      {"intptr_t", check_value<std::intptr_t>},
+      {"uintptr_t", check_value<std::uintptr_t>},
+      {"std::int8_t", check_value<std::int8_t>},
+      {"std::int16_t", check_value<std::int16_t>},
+      {"std::int32_t", check_value<std::int32_t>},
+      {"std::int64_t", check_value<std::int64_t>},
+      {"std::uint8_t", check_value<std::uint8_t>},
+      {"std::uint16_t", check_value<std::uint16_t>},
+      {"std::uint32_t", check_value<std::uint32_t>},
+      {"std::uint64_t", check_value<std::uint64_t>},
+      {"std::size_t", check_value<std::size_t>},
+      {"std::ptrdiff_t", check_value<std::ptrdiff_t>},
+      {"std::intptr_t", check_value<std::intptr_t>},
+      {"std::uintptr_t", check_value<std::uintptr_t>},
+      {"std::string", check_value<std::string>},
+      {"YAML::Node", check_value<YAML::Node>},
+  };
+  return value_types;
+}
+
+inline Status Schema::load(const YAML::Node &spec) {
+  *this = Schema();
+  if (!spec.IsMap()) {
+    return Status::bad_conversion(spec, spec_type_info);
+  }
+  const YAML::Node types_node = spec["Types"];
+  if (!types_node) {
+    return Status::missing_key(spec_type_info, 2, spec.Mark());
+  }
+  if (!types_node.IsMap()) {
+    return Status::bad_conversion(types_node.Mark());
+  }
+  // Declare all types first, so that they can be used before their declaration.
+  std::vector<std::pair<SchemaType *, YAML::Node>> map_types;
+  for (const auto &it : types_node) {
+    const std::string &name = it.first.Scalar();
+    const YAML::Node &info = it.second;
+    Declaration declaration{.id = type_names.size()};
+    if (info.IsMap() || info.IsSequence()) {
+      SchemaType *type = add({.kind = info.IsMap() ? SchemaType::Kind::map_type : SchemaType::Kind::enum_type,
+          .comparable = info.IsSequence(),
+          .name = name});
+      for (const auto &field : info) {
+        const YAML::Node &key = info.IsMap() ? field.first : field;
+        if (!key.IsScalar()) {
+          return Status::bad_conversion(key.Mark());
+        }
+        type->keys.push_back(key.Scalar());
+        // Just like yavl-compile, only fields that are declared as std::optional are optional.
+        type->required.push_back(!info.IsMap() || !field.second.Scalar().starts_with("std::optional<"));
+      }
+      for (std::size_t i = 0; i < type->keys.size(); ++i) {
+        type->key_indices.try_emplace(type->keys[i], i);
+      }
+      type->key_names.assign(type->keys.begin(), type->keys.end());
+      type->info = {type->name, type->key_names};
+      if (info.IsMap()) {
+        map_types.emplace_back(type, info);
+      }
+      declaration.type = type;
+    } else if (info.IsScalar()) {
+      declaration.alias = info;
+    } else {
+      return Status::other("Invalid declaration of type \"" + name + "\"", info.Mark());
+    }
+    if (!declarations.try_emplace(name, declaration).second) {
+      return Status::duplicate_map_item(it.first.Mark());
+    }
+    type_names.push_back(name);
+  }
+  for (const auto &name : type_names) {
+    if (Status status = resolve(name, declarations.at(name)); !status) {
+      return status;
+    }
+    types.push_back(declarations.at(name).type);
+  }
+  for (auto &[type, info] : map_types) {
+    for (const auto &field : info) {
+      const SchemaType *field_type;
+      if (Status status = resolve(field.second, field_type); !status) {
+        return status;
+      }
+      type->children.push_back(field_type);
+    }
+  }
+  return Status();
+}
+
+inline bool Schema::parse(std::string_view text, std::size_t &pos, TypeExpression &expression) {
+  const auto skip_spaces = [&] {
+    while (pos < text.size() && text[pos] == ' ') {
+      ++pos;
+    }
+  };
+  const auto is_name_char = [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+  };
+  skip_spaces();
+  // Names may consist of several words, e.g. `unsigned long long`.
+  while (pos < text.size() && is_name_char(text[pos])) {
+    if (!expression.name.empty()) {
+      expression.name += ' ';
+    }
+    const std::size_t start = pos;
+    while (pos < text.size() && is_name_char(text[pos])) {
+      ++pos;
+    }
+    expression.name.append(text.substr(start, pos - start));
+    skip_spaces();
+  }
+  if (expression.name.empty()) {
+    return false;
+  }
+  if (pos < text.size() && text[pos] == '<') {
+    do {
+      ++pos;
+      if (!parse(text, pos, expression.arguments.emplace_back())) {
+        return false;
+      }
+    } while (pos < text.size() && text[pos] == ',');
+    if (pos >= text.size() || text[pos] != '>') {
+      return false;
+    }
+    ++pos;
+    skip_spaces();
+  }
+  while (pos < text.size() && text[pos] == '[') {
+    ++pos;
+    skip_spaces();
+    std::size_t extent;
+    const auto result = std::from_chars(text.data() + pos, text.data() + text.size(), extent);
+    if (result.ec != std::errc()) {
+      return false;
+    }
+    pos = result.ptr - text.data();
+    skip_spaces();
+    if (pos >= text.size() || text[pos] != ']') {
+      return false;
+    }
+    ++pos;
+    skip_spaces();
+    expression.extents.push_back(extent);
+  }
+  return true;
+}
+
+inline Status Schema::resolve(const YAML::Node &node, const SchemaType *&type) {
+  if (!node.IsScalar()) {
+    return Status::bad_conversion(node.Mark());
+  }
+  const std::string &text = node.Scalar();
+  TypeExpression expression;
+  std::size_t pos = 0;
+  if (!parse(text, pos, expression) || pos != text.size()) {
+    return Status::other("Invalid type \"" + text + "\"", node.Mark());
+  }
+  return resolve(expression, node.Mark(), type);
+}
+
+inline Status Schema::resolve(const std::string &name, Declaration &declaration) {
+  if (declaration.type) {
+    return Status();
+  }
+  if (declaration.resolving) {
+    return Status::other("Circular alias \"" + name + "\"", declaration.alias.Mark());
+  }
+  declaration.resolving = true;
+  const SchemaType *type;
+  Status status = resolve(declaration.alias, type);
+  declaration.resolving = false;
+  if (status) {
+    declaration.type = type;
+  }
+  return status;
+}
+
+inline Status Schema::resolve(const TypeExpression &expression, const YAML::Mark &mark, const SchemaType *&type) {
+  const std::string &name = expression.name;
+  const auto &arguments = expression.arguments;
+  if (arguments.empty()) {
+    if (const auto it = declarations.find(name); it != declarations.end()) {
+      if (Status status = resolve(name, it->second); !status) {
+        return status;
+      }
+      type = it->second.type;
+    } else if (const auto value_type = schema_value_types().find(name); value_type != schema_value_types().end()) {
+      type = add({.check = value_type->second, .comparable = name != "YAML::Node"});
+    } else {
+      return Status::other("Unknown type \"" + name + "\"", mark);
+    }
+  } else if (name == "YAVL::lazy") {
+    // Validation is always eager, so a lazy value is checked like the value it holds.
+    if (arguments.size() != 1) {
+      return Status::other("Invalid arguments for \"" + name + "\"", mark);
+    }
+    if (Status status = resolve(arguments.front(), mark, type); !status) {
+      return status;
+    }
+  } else {
+    SchemaType result;
+    std::size_t arity = 1;
+    if (name == "std::array") {
+      result.kind = SchemaType::Kind::fixed_sequence;
+      arity = 2;
+      const std::string &length = arguments.back().name;
+      if (arguments.size() != arity || !arguments.back().arguments.empty() || !arguments.back().extents.empty()
+          || std::from_chars(length.data(), length.data() + length.size(), result.length).ptr
+              != length.data() + length.size()) {
+        return Status::other("Invalid arguments for \"" + name + "\"", mark);
+      }
+    } else if (name == "std::vector") {
+      result.kind = SchemaType::Kind::sequence;
+    } else if (name == "std::set" || name == "std::unordered_set" || name == "tsl::ordered_set") {
+      result.kind = SchemaType::Kind::set;
+    } else if (name == "std::map" || name == "std::unordered_map" || name == "tsl::ordered_map") {
+      result.kind = SchemaType::Kind::map;
+      arity = 2;
+    } else if (name == "std::tuple") {
+      result.kind = SchemaType::Kind::tuple;
+      arity = arguments.size();
+    } else if (name == "std::optional") {
+      result.kind = SchemaType::Kind::optional;
+    } else {
+      return Status::other("Unknown type \"" + name + "\"", mark);
+    }
+    if (arguments.size() != arity) {
+      return Status::other("Invalid arguments for \"" + name + "\"", mark);
+    }
+    const std::size_t num_types = result.kind == SchemaType::Kind::fixed_sequence ? 1 : arity;
+    for (std::size_t i = 0; i < num_types; ++i) {
+      const SchemaType *child;
+      if (Status status = resolve(arguments[i], mark, child); !status) {
+        return status;
+      }
+      result.children.push_back(child);
+      result.comparable = result.comparable && child->comparable;
+    }
+    if ((result.kind == SchemaType::Kind::set || result.kind == SchemaType::Kind::map)
+        && !result.children.front()->comparable) {
+      return Status::other("Type \"" + arguments.front().name + "\" can't be used in \"" + name + "\"", mark);
+    }
+    type = add(std::move(result));
+  }
+  // `T[2][3]` is an array of 2 arrays of 3 items of `T`, so the last extent is the innermost one.
+  for (auto extent = expression.extents.rbegin(); extent != expression.extents.rend(); ++extent) {
+    type = add({.kind = SchemaType::Kind::fixed_sequence,
+        .children = {type},
+        .length = *extent,
+        .comparable = type->comparable});
+  }
+  return Status();
+}
+
+inline Status Schema::check(const SchemaType &type, const YAML::Node &node, SchemaKey *key) {
+  // Every check mirrors the decoder of the corresponding C++ type, see convert.h and the map and
+  // enum decoders generated by yavl-compile.
+  if (type.kind != SchemaType::Kind::optional && !node.IsDefined()) {
+    return Status::bad_conversion(YAML::Mark::null_mark());
+  }
+  switch (type.kind) {
+    case SchemaType::Kind::value:
+      return type.check(node, key);
+    case SchemaType::Kind::optional:
+      if (node.IsDefined() && !node.IsNull()) {
+        return check(*type.children[0], node, key);
+      }
+      return Status();
+    case SchemaType::Kind::sequence:
+    case SchemaType::Kind::fixed_sequence:
+    case SchemaType::Kind::tuple: {
+      if (!node.IsSequence() && !node.IsNull()) {
+        return Status::bad_conversion(node.Mark());
+      }
+      const std::size_t length = type.kind == SchemaType::Kind::tuple ? type.children.size() : type.length;
+      if (type.kind != SchemaType::Kind::sequence && node.size() != length) {
+        return Status::invalid_sequence_length(length, node.size(), node.Mark());
+      }
+      std::vector<SchemaKey> items;
+      std::size_t i = 0;
+      for (const auto &it : node) {
+        const SchemaType &item_type = type.kind == SchemaType::Kind::tuple ? *type.children[i++] : *type.children[0];
+        if (Status status = check(item_type, it, key ? &items.emplace_back() : nullptr); !status) {
+          return status;
+        }
+      }
+      if (key) {
+        key->value = std::move(items);
+      }
+      return Status();
+    }
+    case SchemaType::Kind::set: {
+      if (!node.IsSequence() && !node.IsNull()) {
+        return Status::bad_conversion(node.Mark());
+      }
+      std::set<SchemaKey> items;
+      for (const auto &it : node) {
+        SchemaKey item;
+        if (Status status = check(*type.children[0], it, &item); !status) {
+          return status;
+        }
+        if (!items.insert(std::move(item)).second) {
+          return Status::duplicate_set_item(it.Mark());
+        }
+      }
+      if (key) {
+        key->value = std::vector<SchemaKey>(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+      }
+      return Status();
+    }
+    case SchemaType::Kind::map: {
+      if (!node.IsMap() && !node.IsNull()) {
+        return Status::bad_conversion(node.Mark());
+      }
+      std::map<SchemaKey, SchemaKey> items;
+      for (const auto &it : node) {
+        SchemaKey item_key;
+        if (Status status = check(*type.children[0], it.first, &item_key); !status) {
+          return status;
+        }
+        auto [slot, inserted] = items.try_emplace(std::move(item_key));
+        if (!inserted) {
+          return Status::duplicate_map_item(it.first.Mark());
+        }
+        if (Status status = check(*type.children[1], it.second, key ? &slot->second : nullptr); !status) {
+          return status;
+        }
+      }
+      if (key) {
+        std::vector<SchemaKey> flat;
+        for (auto &[item_key, value] : items) {
+          flat.push_back(item_key);
+          flat.push_back(std::move(value));
+        }
+        key->value = std::move(flat);
+      }
+      return Status();
+    }
+    case SchemaType::Kind::map_type: {
+      if (!node.IsMap() && !node.IsNull()) {
+        return Status::bad_conversion(node, type.info);
+      }
+      std::vector<bool> found(type.keys.size());
+      std::optional<YAML::Node> superfluous_key;
+      for (const auto &it : node) {
+        if (!it.first.IsScalar()) {
+          return Status::bad_conversion(it.first.Mark());
+        }
+        const auto index = type.key_indices.find(it.first.Scalar());
+        if (index == type.key_indices.end()) {
+          if (!superfluous_key) {
+            superfluous_key = it.first;
+          }
+          continue;
+        }
+        if (found[index->second]) {
+          return Status::duplicate_map_item(it.first.Mark());
+        }
+        found[index->second] = true;
+        if (Status status = check(*type.children[index->second], it.second); !status) {
+          return status;
+        }
+      }
+      for (std::size_t i = 0; i < type.keys.size(); ++i) {
+        if (!found[i] && type.required[i]) {
+          return Status::missing_key(type.info, i, node.Mark());
+        }
+      }
+      if (superfluous_key) {
+        return Status::superfluous_key(type.info, superfluous_key->Scalar(), superfluous_key->Mark());
+      }
+      return Status();
+    }
+    case SchemaType::Kind::enum_type: {
+      const auto index = type.key_indices.find(node.Scalar());
+      if (index == type.key_indices.end()) {
+        return Status::bad_conversion(node, type.info);
+      }
+      if (key) {
+        key->value = static_cast<std::uint64_t>(index->second);
+      }
+      return Status();
+    }
+  }
+  return Status();
+}
+
+} // namespace YAVL
@@ -15,27 +15,119 @@ struct SpecType {
   tsl::ordered_map<std::string, YAML::Node> Types;
 };
 
-inline void operator>>(const YAML::Node &input, SpecType &output) {
-  const std::unordered_map<std::string, bool> keys = {
-    {"ExtraIncludes", false},
-    {"CustomCodeGenerator", false},
-    {"Types", true}
-  };
-  for (const auto &[key, is_required] : keys) {
-    if (is_required && !input[key]) {
-      throw YAVL::MissingKeyException("SpecType", key);
+template<>
+inline std::size_t YAVL::key_index<SpecType>(std::string_view key) {
+  switch (key.size()) {
+    case 5:
+      return key == "Types" ? 2 : YAVL::npos;
+    case 13:
+      return key == "ExtraIncludes" ? 0 : YAVL::npos;
+    case 19:
+      return key == "CustomCodeGenerator" ? 1 : YAVL::npos;
+  }
+  return YAVL::npos;
+}
+
+template<>
+struct YAVL::map_traits<SpecType> {
+  static constexpr const char *name = "SpecType";
+  static constexpr std::array<std::string_view, 3> keys = {"ExtraIncludes", "CustomCodeGenerator", "Types"};
+  static constexpr std::array<bool, 3> required = {false, false, true};
+  static constexpr YAVL::TypeInfo info = {name, keys};
+
+  template<typename F>
+  static void visit(SpecType &obj, std::size_t index, F &&f) {
+    switch (index) {
+      case 0:
+        f(obj.ExtraIncludes);
+        break;
+      case 1:
+        f(obj.CustomCodeGenerator);
+        break;
+      case 2:
+        f(obj.Types);
+        break;
     }
   }
-  for (const auto &it : input) {
-    const std::string key = it.first.as<std::string>();
-    if (!keys.contains(key)) {
-      throw YAVL::SuperfluousKeyException("SpecType", key);
+
+  template<typename F>
+  static void visit_type(std::size_t index, F &&f) {
+    switch (index) {
+      case 0:
+        f(std::type_identity<decltype(SpecType::ExtraIncludes)>());
+        break;
+      case 1:
+        f(std::type_identity<decltype(SpecType::CustomCodeGenerator)>());
+        break;
+      case 2:
+        f(std::type_identity<decltype(SpecType::Types)>());
+        break;
     }
   }
-  input["ExtraIncludes"] >> output.ExtraIncludes;
-  input["CustomCodeGenerator"] >> output.CustomCodeGenerator;
-  input["Types"] >> output.Types;
-}
+};
+
+template<>
+struct YAVL::fields<SpecType> {
+  static constexpr auto ExtraIncludes = YAVL::FieldMask<SpecType>::of(0);
+  static constexpr auto CustomCodeGenerator = YAVL::FieldMask<SpecType>::of(1);
+  static constexpr auto Types = YAVL::FieldMask<SpecType>::of(2);
+};
+
+template<>
+struct YAVL::decoder<SpecType> {
+  static YAVL::Status decode(const YAML::Node &input, SpecType &output) {
+    if (!input.IsMap() && !input.IsNull()) {
+      return YAVL::Status::bad_conversion(input, YAVL::map_traits<SpecType>::info);
+    }
+    std::bitset<3> found;
+    std::optional<YAML::Node> superfluous_key;
+    for (const auto &it : input) {
+      if (!it.first.IsScalar()) {
+        return YAVL::Status::bad_conversion(it.first.Mark());
+      }
+      const std::string &key = it.first.Scalar();
+      const std::size_t index = YAVL::key_index<SpecType>(key);
+      if (index == YAVL::npos) {
+        if (!superfluous_key) {
+          superfluous_key = it.first;
+        }
+        continue;
+      }
+      if (found.test(index)) {
+        return YAVL::Status::duplicate_map_item(it.first.Mark());
+      }
+      found.set(index);
+      YAVL::Status status;
+      switch (index) {
+        case 0:
+          status = YAVL::decode(it.second, output.ExtraIncludes);
+          break;
+        case 1:
+          status = YAVL::decode(it.second, output.CustomCodeGenerator);
+          break;
+        case 2:
+          status = YAVL::decode(it.second, output.Types);
+          break;
+      }
+      if (!status) {
+        return status;
+      }
+    }
+    if (!found.test(0)) {
+      output.ExtraIncludes = std::nullopt;
+    }
+    if (!found.test(1)) {
+      output.CustomCodeGenerator = std::nullopt;
+    }
+    if (!found.test(2)) {
+      return YAVL::Status::missing_key(YAVL::map_traits<SpecType>::info, 2, input.Mark());
+    }
+    if (superfluous_key) {
+      return YAVL::Status::superfluous_key(YAVL::map_traits<SpecType>::info, superfluous_key->Scalar(), superfluous_key->Mark());
+    }
+    return YAVL::Status();
+  }
+};
 
 inline YAML::Emitter& operator<<(YAML::Emitter &output, const SpecType &input) {
   output << YAML::BeginMap;
@@ -49,16 +141,91 @@ inline YAML::Emitter& operator<<(YAML::Emitter &output, const SpecType &input) {
   return output;
 }
 
-inline std::vector<std::string> get_types() {
-  return {
-    "SpecType"
-  };
+template<>
+struct YAVL::binary_schema<SpecType> {
+  static constexpr std::uint64_t hash = 0x2acbd2dab76dd88a;
+};
+
+template<>
+struct YAVL::binary_codec<SpecType> {
+  static void write(const SpecType &input, YAVL::Buffer &output) {
+    YAVL::write_binary(input.ExtraIncludes, output);
+    YAVL::write_binary(input.CustomCodeGenerator, output);
+    YAVL::write_binary(input.Types, output);
+  }
+
+  static YAVL::Status read(YAVL::BinaryInput &input, SpecType &output) {
+    if (YAVL::Status status = YAVL::read_binary(input, output.ExtraIncludes); !status) {
+      return status;
+    }
+    if (YAVL::Status status = YAVL::read_binary(input, output.CustomCodeGenerator); !status) {
+      return status;
+    }
+    if (YAVL::Status status = YAVL::read_binary(input, output.Types); !status) {
+      return status;
+    }
+    return YAVL::Status();
+  }
+};
+
+inline constexpr std::array<std::string_view, 1> type_names = {"SpecType"};
+
+inline std::span<const std::string_view> get_types() {
+  return type_names;
+}
+
+inline std::size_t get_type_id(std::string_view type_name) {
+  switch (type_name.size()) {
+    case 8:
+      return type_name == "SpecType" ? 0 : YAVL::npos;
+  }
+  return YAVL::npos;
+}
+
+inline YAVL::validation_result validate_by_id(const YAML::Node &node, std::size_t type_id) {
+  switch (type_id) {
+    case 0:
+      return validate<SpecType>(node);
+  }
+  return {false, YAVL::Status::other("Unknown type")};
+}
+
+inline YAVL::validation_result validate_simple(const YAML::Node &node, std::string_view type_name) {
+  return validate_by_id(node, get_type_id(type_name));
+}
+
+inline void validate_many_by_id(const YAML::Node *nodes, std::size_t count, std::size_t type_id, YAVL::validation_result *results) {
+  switch (type_id) {
+    case 0:
+      validate_many<SpecType>(nodes, count, results);
+      return;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    results[i] = {false, YAVL::Status::other("Unknown type")};
+  }
+}
+
+#ifdef __cpp_exceptions
+inline YAVL::validation_result validate_stream_by_id(std::istream &input, std::size_t type_id) {
+  switch (type_id) {
+    case 0:
+      return validate_stream<SpecType>(input);
+  }
+  return {false, YAVL::Status::other("Unknown type")};
+}
+
+inline YAVL::validation_result validate_stream_simple(std::istream &input, std::string_view type_name) {
+  return validate_stream_by_id(input, get_type_id(type_name));
 }
 
-inline std::tuple<bool, std::optional<std::string>> validate_simple(const YAML::Node &node, const std::string type_name) {
-  if (type_name == "SpecType") {
-    return validate<SpecType>(node);
+template<typename F>
+inline void validate_stream_documents_by_id(std::istream &input, std::size_t type_id, F &&f) {
+  switch (type_id) {
+    case 0:
+      validate_stream_documents<SpecType>(input, f);
+      return;
   }
-  return std::make_tuple(false, std::nullopt);
+  f(0, YAVL::validation_result{false, YAVL::Status::other("Unknown type")});
 }
 
+#endif // __cpp_exceptions
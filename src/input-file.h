@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cerrno>
+#include <fcntl.h>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+
+#include "yavl-cpp/runtime.h"
+
+/**
+ * The contents of an input file, for documents that are parsed as a whole. Regular files are mapped
+ * into memory and read ahead sequentially, anything else (e.g. pipes or `/dev/stdin`) is read into a
+ * buffer. Streamed documents are read with `InputStream` instead.
+ */
+class InputFile {
+  public:
+    explicit InputFile(const std::string &filename) {
+      const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return;
+      }
+      struct stat info;
+      if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+          madvise(data, info.st_size, MADV_SEQUENTIAL);
+          mapping = data;
+          mapping_size = info.st_size;
+          good = true;
+          close(fd);
+          return;
+        }
+      }
+      char chunk[65536];
+      ssize_t n;
+      while ((n = read(fd, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR)) {
+        if (n > 0) {
+          buffer.append(chunk, n);
+        }
+      }
+      good = n == 0;
+      close(fd);
+    }
+
+    InputFile(const InputFile &) = delete;
+    InputFile &operator=(const InputFile &) = delete;
+
+    ~InputFile() {
+      if (mapping) {
+        munmap(mapping, mapping_size);
+      }
+    }
+
+    // Whether the file could be opened and read.
+    bool is_open() const {
+      return good;
+    }
+
+    std::string_view contents() const {
+      return mapping ? std::string_view(static_cast<const char *>(mapping), mapping_size) : std::string_view(buffer);
+    }
+
+  private:
+    void *mapping = nullptr;
+    std::size_t mapping_size = 0;
+    std::string buffer;
+    bool good = false;
+};
+
+/**
+ * Reads a file piece by piece through a `YAVL::DocumentReader`, so that the memory usage doesn't
+ * grow with the size of the file, no matter whether it is a regular file or a pipe.
+ */
+class InputStream {
+  public:
+    explicit InputStream(const std::string &filename) : fd(open(filename.c_str(), O_RDONLY | O_CLOEXEC)) {
+      if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      }
+    }
+
+    InputStream(const InputStream &) = delete;
+    InputStream &operator=(const InputStream &) = delete;
+
+    ~InputStream() {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+
+    bool is_open() const {
+      return fd >= 0;
+    }
+
+    // Whether reading failed before the end of the file, which the reader reports as the end.
+    bool failed() const {
+      return read_error;
+    }
+
+    YAVL::DocumentReader reader() {
+      return {[](void *context, char *buffer, std::size_t size) -> std::size_t {
+                auto &input = *static_cast<InputStream *>(context);
+                ssize_t n;
+                while ((n = read(input.fd, buffer, size)) < 0 && errno == EINTR) {
+                }
+                input.read_error = input.read_error || n < 0;
+                return n > 0 ? static_cast<std::size_t>(n) : 0;
+              },
+          this};
+    }
+
+  private:
+    int fd;
+    bool read_error = false;
+};
+
+/**
+ * Reads directly from a buffer in memory, without copying it into a string stream.
+ */
+class InputBuffer : public std::streambuf {
+  public:
+    explicit InputBuffer(std::string_view contents) {
+      // The get area is never written to, so the buffer may be read-only.
+      char *begin = const_cast<char *>(contents.data());
+      setg(begin, begin, begin + contents.size());
+    }
+};
+
+/**
+ * A replacement for `YAML::LoadFile` that reads the file through `InputFile`. Throws the same
+ * exceptions.
+ */
+inline YAML::Node load_file(const std::string &filename) {
+  const InputFile file(filename);
+  if (!file.is_open()) {
+    throw YAML::BadFile(filename);
+  }
+  InputBuffer buffer(file.contents());
+  std::istream input(&buffer);
+  return YAML::Load(input);
+}
@@ -1,9 +1,87 @@
 #include "spec.h"
 
+namespace {
+
+// The names in `type_names` are string literals, so they can be passed on as C strings.
+const auto type_name_pointers = [] {
+  std::array<const char *, type_names.size()> pointers{};
+  for (std::size_t i = 0; i < type_names.size(); ++i) {
+    pointers[i] = type_names[i].data();
+  }
+  return pointers;
+}();
+
+// The messages of the reports that were handed out to each thread. They stay valid until its next call.
+thread_local std::vector<std::string> messages;
+
+std::size_t get_type_id_symbol(const char *type_name, std::size_t length) {
+  return get_type_id(std::string_view(type_name, length));
+}
+
+void validate_by_id_symbol(YAVL::DocumentBytes document, std::size_t type_id, YAVL::ValidationReport *report) {
+  messages.resize(1);
+  *report = YAVL::make_report(
+      YAVL::validate_document(document, [&](const YAML::Node &node) { return validate_by_id(node, type_id); }),
+      messages[0]);
+}
+
+void validate_many_symbol(
+    const YAVL::DocumentBytes *documents, std::size_t count, std::size_t type_id, YAVL::ValidationReport *reports) {
+  thread_local std::vector<YAML::Node> nodes;
+  thread_local std::vector<std::size_t> indices;
+  thread_local std::vector<YAVL::validation_result> results;
+  messages.resize(count);
+  nodes.clear();
+  indices.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (YAVL::Status status = YAVL::parse_document(documents[i], nodes.emplace_back()); !status) {
+      nodes.pop_back();
+      reports[i] = YAVL::make_report({false, std::move(status)}, messages[i]);
+      continue;
+    }
+    indices.push_back(i);
+  }
+  // The documents that could be parsed are validated with a single dispatch on the type.
+  results.resize(nodes.size());
+  validate_many_by_id(nodes.data(), nodes.size(), type_id, results.data());
+  for (std::size_t j = 0; j < results.size(); ++j) {
+    reports[indices[j]] = YAVL::make_report(results[j], messages[indices[j]]);
+  }
+  nodes.clear();
+}
+
+void validate_stream_by_id_symbol(YAVL::DocumentReader reader, std::size_t type_id, YAVL::ValidationReport *report) {
+  messages.resize(1);
+  YAVL::DocumentReaderBuffer buffer(reader);
+  std::istream input(&buffer);
+  *report = YAVL::make_report(validate_stream_by_id(input, type_id), messages[0]);
+}
+
+void validate_stream_documents_by_id_symbol(YAVL::DocumentReader reader, std::size_t type_id,
+    bool (*callback)(void *context, std::size_t index, const YAVL::ValidationReport *report), void *context) {
+  YAVL::DocumentReaderBuffer buffer(reader);
+  std::istream input(&buffer);
+  std::string message;
+  validate_stream_documents_by_id(input, type_id, [&](std::size_t index, const YAVL::validation_result &result) {
+    const YAVL::ValidationReport report = YAVL::make_report(result, message);
+    return callback(context, index, &report);
+  });
+}
+
+const YAVL::SymbolTable symbols = {.version = YAVL::symbol_table_version,
+    .num_types = type_names.size(),
+    .type_names = type_name_pointers.data(),
+    .get_type_id = get_type_id_symbol,
+    .validate_by_id = validate_by_id_symbol,
+    .validate_many = validate_many_symbol,
+    .validate_stream_by_id = validate_stream_by_id_symbol,
+    .validate_stream_documents_by_id = validate_stream_documents_by_id_symbol};
+
+} // namespace
+
 extern "C" {
 
-YAVL::SymbolTable get_symbols() {
-  const YAVL::SymbolTable symbols = {.validate_simple = validate_simple, .get_types = get_types};
-  return symbols;
+const YAVL::SymbolTable *get_symbols() {
+  return &symbols;
 }
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <dlfcn.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "yavl-cpp/runtime.h"
+
+typedef const YAVL::SymbolTable *(*get_symbols_ptr)();
+
+/**
+ * Keeps a spec library loaded and provides its symbol table.
+ */
+class SpecLibrary {
+  public:
+    explicit SpecLibrary(const std::string &filename)
+        : handle(dlopen(filename.c_str(), RTLD_LAZY), [](void *ptr) {
+            if (ptr) {
+              dlclose(ptr);
+            }
+          }) {
+      if (!handle) {
+        error = std::string("\"") + dlerror() + "\"";
+        return;
+      }
+      const get_symbols_ptr get_symbols = (get_symbols_ptr)dlsym(handle.get(), "get_symbols");
+      if (const char *dlsym_error = dlerror(); !get_symbols || dlsym_error) {
+        error = std::string("\"") + (dlsym_error ? dlsym_error : "get_symbols not found") + "\"";
+        return;
+      }
+      symbols = get_symbols();
+      if (symbols->version != YAVL::symbol_table_version) {
+        error = "\"" + filename + "\" has symbol table version " + std::to_string(symbols->version) + ", expected "
+            + std::to_string(YAVL::symbol_table_version);
+        symbols = nullptr;
+      }
+    }
+
+    // The symbol table, or nullptr if the library could not be loaded. See `error` in that case.
+    const YAVL::SymbolTable *symbols = nullptr;
+    std::string error;
+
+  private:
+    std::unique_ptr<void, std::function<void(void *)>> handle;
+};
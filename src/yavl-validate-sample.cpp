@@ -1,62 +1,349 @@
-#include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <deque>
 #include <fstream>
-#include <functional>
+#include <glob.h>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <vector>
 #include <yaml-cpp/yaml.h>
 
+#include "input-file.h"
+#include "spec-library.h"
 #include "yavl-cpp/runtime.h"
+#include "yavl-cpp/schema.h"
 
 using YAVL::SymbolTable;
-typedef SymbolTable (*get_symbols_ptr)();
+
+// Number of documents a worker claims and validates with a single call in batch mode.
+constexpr std::size_t batch_size = 16;
 
 void usage(const std::string &app_name) {
-  std::cerr << "Usage: " << app_name << " DOC LIB TYPENAME" << std::endl;
+  std::cerr << "Usage: " << app_name << " [--stream | --interpret] DOC LIB TYPENAME" << std::endl
+            << "       " << app_name << " --all [--fail-fast] DOC LIB TYPENAME" << std::endl
+            << "       " << app_name
+            << " [--stream | --interpret] [--jobs N] [--files-from LIST] --batch LIB TYPENAME [DOC...]" << std::endl
+            << std::endl
+            << "  --stream           Validate documents directly from the parser events without loading them into"
+            << std::endl
+            << "                     memory. Aliases are not supported, and duplicate items of sets and keys of maps"
+            << std::endl
+            << "                     are only detected if they are scalars." << std::endl
+            << "  --all              Validate every document of a multi-document stream one after another, in"
+            << std::endl
+            << "                     constant memory, and report the result for each of them." << std::endl
+            << "  --fail-fast        With --all, stop at the first invalid document." << std::endl
+            << "  --interpret        LIB is a YAVL spec, which is loaded at runtime instead of being compiled." << std::endl
+            << "  --batch            Validate any number of documents in parallel and report the result for each of"
+            << std::endl
+            << "                     them. DOC may also be a glob pattern, e.g. 'configs/*.yaml'." << std::endl
+            << "  --files-from LIST  In batch mode, also validate the documents listed in LIST, one per line. Use \"-\""
+            << std::endl
+            << "                     to read the list from stdin." << std::endl
+            << "  --jobs N           In batch mode, use N worker threads instead of one per hardware thread (or a"
+            << std::endl
+            << "                     single one if that number is unknown). N must be positive." << std::endl;
 }
 
-int main(int argc, char **argv) {
-  if (argc < 4) {
-    usage(argv[0]);
-    return EXIT_FAILURE;
+struct Options {
+    bool stream = false;
+    bool interpret = false;
+    bool batch = false;
+    bool all = false;
+    bool fail_fast = false;
+    std::optional<std::string> files_from;
+    unsigned jobs = 0;
+    std::vector<std::string> args;
+};
+
+std::optional<Options> parse_options(int argc, char **argv) {
+  Options options;
+  int i = 1;
+  for (; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--stream") {
+      options.stream = true;
+    } else if (arg == "--interpret") {
+      options.interpret = true;
+    } else if (arg == "--batch") {
+      options.batch = true;
+    } else if (arg == "--all") {
+      options.all = true;
+    } else if (arg == "--fail-fast") {
+      options.fail_fast = true;
+    } else if (arg == "--files-from" && i + 1 < argc) {
+      options.files_from = argv[++i];
+    } else if (arg == "--jobs" && i + 1 < argc) {
+      // from_chars rejects signs, which std::stoul would accept and wrap around. More jobs than
+      // hardware threads are allowed, since the documents may take longer to read than to validate.
+      const std::string_view value = argv[++i];
+      const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.jobs);
+      if (error != std::errc() || end != value.data() + value.size() || options.jobs == 0) {
+        return std::nullopt;
+      }
+    } else if (arg.starts_with("--")) {
+      return std::nullopt;
+    } else {
+      break;
+    }
+  }
+  options.args.assign(argv + i, argv + argc);
+  const std::size_t min_args = options.batch ? 2 : 3;
+  if (options.args.size() < min_args || (!options.batch && (options.files_from || options.jobs))
+      || (options.stream && options.interpret) || (options.fail_fast && !options.all)
+      || (options.all && (options.stream || options.interpret || options.batch))) {
+    return std::nullopt;
+  }
+  return options;
+}
+
+// The spec loaded with --interpret. The symbol table forwards to it, so that it is used just like a
+// compiled library.
+YAVL::Schema interpreted_schema;
+thread_local std::vector<std::string> interpreted_messages;
+const SymbolTable interpreted_symbols = {.version = YAVL::symbol_table_version,
+    .num_types = 0,
+    .type_names = nullptr,
+    .get_type_id = [](const char *type_name,
+                       std::size_t length) { return interpreted_schema.get_type_id(std::string_view(type_name, length)); },
+    .validate_by_id =
+        [](YAVL::DocumentBytes document, std::size_t type_id, YAVL::ValidationReport *report) {
+          interpreted_messages.resize(1);
+          *report = YAVL::make_report(YAVL::validate_document(document,
+                                          [&](const YAML::Node &node) {
+                                            return interpreted_schema.validate_by_id(node, type_id);
+                                          }),
+              interpreted_messages[0]);
+        },
+    .validate_many =
+        [](const YAVL::DocumentBytes *documents, std::size_t count, std::size_t type_id,
+            YAVL::ValidationReport *reports) {
+          interpreted_messages.resize(count);
+          for (std::size_t i = 0; i < count; ++i) {
+            reports[i] = YAVL::make_report(YAVL::validate_document(documents[i],
+                                               [&](const YAML::Node &node) {
+                                                 return interpreted_schema.validate_by_id(node, type_id);
+                                               }),
+                interpreted_messages[i]);
+          }
+        },
+    .validate_stream_by_id = nullptr,
+    .validate_stream_documents_by_id = nullptr};
+
+int validate_single(const Options &options, const SymbolTable &symbols, std::size_t type_id) {
+  const std::string &doc_filename = options.args[0];
+  YAVL::ValidationReport report;
+  if (options.stream) {
+    InputStream doc_stream(doc_filename);
+    if (!doc_stream.is_open()) {
+      std::cerr << "Error: Unable to open \"" << doc_filename << "\"" << std::endl;
+      return EXIT_FAILURE;
+    }
+    symbols.validate_stream_by_id(doc_stream.reader(), type_id, &report);
+    if (doc_stream.failed()) {
+      std::cerr << "Error: Unable to read \"" << doc_filename << "\"" << std::endl;
+      return EXIT_FAILURE;
+    }
+  } else {
+    const InputFile doc_file(doc_filename);
+    if (!doc_file.is_open()) {
+      std::cerr << "Error: Unable to open \"" << doc_filename << "\"" << std::endl;
+      return EXIT_FAILURE;
+    }
+    symbols.validate_by_id({doc_file.contents().data(), doc_file.contents().size()}, type_id, &report);
   }
-  const std::string doc_filename = argv[1];
-  YAML::Node doc;
-  try {
-    doc = YAML::LoadFile(doc_filename);
-  } catch (const YAML::Exception &e) {
-    std::cerr << "Error while parsing document: \"" << e.what() << "\"" << std::endl;
+  if (report.ok) {
+    std::cout << "Validation successful!" << std::endl;
+  } else {
+    std::cerr << "Validation failed!" << std::endl
+              << "Error: " << std::endl
+              << "  " << report.message << std::endl;
     return EXIT_FAILURE;
   }
-  const std::string lib_filename = argv[2];
-  const std::unique_ptr<void, std::function<void(void *)>> handle(
-      dlopen(lib_filename.c_str(), RTLD_LAZY), [](void *ptr) { dlclose(ptr); });
-  if (!handle.get()) {
-    std::cerr << "Error: \"" << dlerror() << "\"" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+// Validates the documents of a multi-document stream one by one, without keeping them in memory.
+int validate_all(const Options &options, const SymbolTable &symbols, std::size_t type_id) {
+  const std::string &doc_filename = options.args[0];
+  InputStream doc_stream(doc_filename);
+  if (!doc_stream.is_open()) {
+    std::cerr << "Error: Unable to open \"" << doc_filename << "\"" << std::endl;
     return EXIT_FAILURE;
   }
-  get_symbols_ptr get_symbols = (get_symbols_ptr)dlsym(handle.get(), "get_symbols");
-  const char *error = dlerror();
-  if (!get_symbols || error) {
-    std::cerr << "Error: \"" << error << "\"" << std::endl;
+
+  struct Context {
+      bool fail_fast;
+      std::size_t count = 0;
+      std::size_t failed = 0;
+  } context{options.fail_fast};
+  const auto print = [](void *data, std::size_t index, const YAVL::ValidationReport *report) {
+    auto &context = *static_cast<Context *>(data);
+    ++context.count;
+    if (report->ok) {
+      std::cout << "document " << index << ": Validation successful!\n";
+      return true;
+    }
+    ++context.failed;
+    std::cout << "document " << index << ": Validation failed!\n"
+              << "  " << report->message << '\n';
+    return !context.fail_fast;
+  };
+  symbols.validate_stream_documents_by_id(doc_stream.reader(), type_id, print, &context);
+  if (doc_stream.failed()) {
+    std::cerr << "Error: Unable to read \"" << doc_filename << "\"" << std::endl;
     return EXIT_FAILURE;
   }
-  SymbolTable symbols = get_symbols();
-  const std::string type_name = argv[3];
-  std::vector<std::string> types = symbols.get_types();
-  if (std::find(types.begin(), types.end(), type_name) == types.end()) {
-    std::cerr << "Invalid type: \"" << type_name << "\"" << std::endl;
+  std::cout << context.count - context.failed << " of " << context.count << " documents are valid." << std::endl;
+  return context.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Expands the glob patterns among `patterns`. Patterns without matches are kept as they are, so that
+// they are reported as missing files.
+std::vector<std::string> expand_globs(const std::vector<std::string> &patterns) {
+  std::vector<std::string> filenames;
+  for (const auto &pattern : patterns) {
+    glob_t matches;
+    if (pattern.find_first_of("*?[") != std::string::npos && glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+      filenames.insert(filenames.end(), matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+      globfree(&matches);
+    } else {
+      filenames.push_back(pattern);
+    }
+  }
+  return filenames;
+}
+
+int validate_batch(const Options &options, const SymbolTable &symbols, std::size_t type_id) {
+  std::vector<std::string> filenames
+      = expand_globs(std::vector<std::string>(options.args.begin() + 2, options.args.end()));
+  if (options.files_from) {
+    std::ifstream list_file;
+    if (*options.files_from != "-") {
+      list_file.open(*options.files_from);
+      if (!list_file) {
+        std::cerr << "Error: Unable to open \"" << *options.files_from << "\"" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    std::istream &list = *options.files_from == "-" ? std::cin : list_file;
+    for (std::string line; std::getline(list, line);) {
+      if (!line.empty()) {
+        filenames.push_back(line);
+      }
+    }
+  }
+
+  // Messages are copied by the workers, since the reports only stay valid until their next call.
+  std::vector<std::optional<std::string>> errors(filenames.size());
+  std::atomic<std::size_t> next = 0;
+  const auto work = [&] {
+    std::deque<InputFile> files;
+    std::vector<YAVL::DocumentBytes> docs;
+    std::vector<std::size_t> indices;
+    std::vector<YAVL::ValidationReport> reports;
+    // Idle workers claim the next few documents, so slow documents don't hold up the others.
+    for (std::size_t first; (first = next.fetch_add(batch_size)) < filenames.size();) {
+      const std::size_t last = std::min(first + batch_size, filenames.size());
+      files.clear();
+      docs.clear();
+      indices.clear();
+      for (std::size_t i = first; i < last; ++i) {
+        if (options.stream) {
+          InputStream doc_stream(filenames[i]);
+          if (!doc_stream.is_open()) {
+            errors[i] = "Unable to open file";
+            continue;
+          }
+          YAVL::ValidationReport report;
+          symbols.validate_stream_by_id(doc_stream.reader(), type_id, &report);
+          if (doc_stream.failed()) {
+            errors[i] = "Unable to read file";
+          } else if (!report.ok) {
+            errors[i] = report.message;
+          }
+          continue;
+        }
+        const InputFile &doc_file = files.emplace_back(filenames[i]);
+        if (!doc_file.is_open()) {
+          errors[i] = "Unable to open file";
+          continue;
+        }
+        docs.push_back({doc_file.contents().data(), doc_file.contents().size()});
+        indices.push_back(i);
+      }
+      reports.resize(docs.size());
+      symbols.validate_many(docs.data(), docs.size(), type_id, reports.data());
+      for (std::size_t j = 0; j < reports.size(); ++j) {
+        if (!reports[j].ok) {
+          errors[indices[j]] = reports[j].message;
+        }
+      }
+    }
+  };
+  // hardware_concurrency() is 0 if the number of hardware threads is unknown.
+  const unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+  {
+    std::vector<std::jthread> workers;
+    for (unsigned i = 0; i < std::min<std::size_t>(jobs, filenames.size()); ++i) {
+      workers.emplace_back(work);
+    }
+  }
+
+  std::size_t failed = 0;
+  for (std::size_t i = 0; i < filenames.size(); ++i) {
+    if (errors[i]) {
+      ++failed;
+      std::cout << filenames[i] << ": Validation failed!" << std::endl << "  " << *errors[i] << std::endl;
+    } else {
+      std::cout << filenames[i] << ": Validation successful!" << std::endl;
+    }
+  }
+  std::cout << filenames.size() - failed << " of " << filenames.size() << " documents are valid." << std::endl;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+  const std::optional<Options> options = parse_options(argc, argv);
+  if (!options) {
+    usage(argv[0]);
     return EXIT_FAILURE;
   }
-  const auto &[ok, error_message] = symbols.validate_simple(doc, type_name);
-  if (ok) {
-    std::cout << "Validation successful!" << std::endl;
+  const std::string &lib_filename = options->args[options->batch ? 0 : 1];
+  std::optional<SpecLibrary> library;
+  const SymbolTable *symbols = &interpreted_symbols;
+  if (options->interpret) {
+    YAML::Node spec;
+    try {
+      spec = load_file(lib_filename);
+    } catch (const YAML::Exception &e) {
+      std::cerr << "Error while parsing spec: \"" << e.what() << "\"" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (const YAVL::Status status = interpreted_schema.load(spec); !status) {
+      std::cerr << "Error: Invalid spec \"" << lib_filename << "\"" << std::endl << "  " << status.message() << std::endl;
+      return EXIT_FAILURE;
+    }
   } else {
-    std::cerr << "Validation failed!" << std::endl
-              << "Error: " << std::endl
-              << "  " << error_message.value_or("(Unknown)") << std::endl;
+    library.emplace(lib_filename);
+    if (!library->symbols) {
+      std::cerr << "Error: " << library->error << std::endl;
+      return EXIT_FAILURE;
+    }
+    symbols = library->symbols;
+  }
+  const std::string &type_name = options->args[options->batch ? 1 : 2];
+  const std::size_t type_id = symbols->get_type_id(type_name.data(), type_name.size());
+  if (type_id == YAVL::npos) {
+    std::cerr << "Invalid type: \"" << type_name << "\"" << std::endl;
     return EXIT_FAILURE;
   }
-  return EXIT_SUCCESS;
+  if (options->all) {
+    return validate_all(*options, *symbols, type_id);
+  }
+  return options->batch ? validate_batch(*options, *symbols, type_id) : validate_single(*options, *symbols, type_id);
 }
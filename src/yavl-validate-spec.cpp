@@ -1,5 +1,6 @@
 #include <iostream>
 
+#include "input-file.h"
 #include "yavl-cpp/spec.h"
 
 void usage(const std::string &app_name) {
@@ -16,16 +17,16 @@ int main(int argc, char **argv) {
   const std::string spec_filename = argv[1];
   YAML::Node spec;
   try {
-    spec = YAML::LoadFile(spec_filename);
+    spec = load_file(spec_filename);
   } catch (const YAML::Exception &e) {
     std::cerr << "Error while parsing document: \"" << e.what() << "\"" << std::endl;
     return EXIT_FAILURE;
   }
-  const auto &[valid_spec, error_message] = validate<SpecType>(spec);
+  const auto &[valid_spec, status] = validate<SpecType>(spec);
   if (!valid_spec) {
     std::cerr << "Validation failed!" << std::endl
               << "Error: " << std::endl
-              << "  " << error_message.value_or("(Unknown)") << std::endl;
+              << "  " << status.message() << std::endl;
     return EXIT_FAILURE;
   }
   std::cout << "Validation successful!" << std::endl;
@@ -0,0 +1,547 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "spec-library.h"
+#include "yavl-cpp/runtime.h"
+
+// Largest document accepted in a single request.
+constexpr std::size_t max_document_size = 64 << 20;
+// Longest request line accepted before the connection is dropped.
+constexpr std::size_t max_header_size = 4096;
+
+void usage(const std::string &app_name) {
+  std::cerr << "Usage: " << app_name << " [--jobs N] [--queue N] [--timeout SECONDS] SOCKET LIB..." << std::endl
+            << std::endl
+            << "Keeps the spec libraries LIB loaded and validates documents sent to the Unix domain socket SOCKET."
+            << std::endl
+            << std::endl
+            << "  --jobs N           Serve N requests at the same time instead of one per hardware thread." << std::endl
+            << "  --queue N          Let at most N connections wait for a worker before no more are accepted"
+            << std::endl
+            << "                     (default: 64)." << std::endl
+            << "  --timeout SECONDS  Close connections that take longer than SECONDS to send a request or to"
+            << std::endl
+            << "                     receive its reply (default: 10)." << std::endl
+            << std::endl
+            << "Requests:" << std::endl
+            << "  VALIDATE TYPENAME SIZE\\n followed by SIZE bytes of YAML" << std::endl
+            << "      Replies \"OK\", \"FAILED <message>\" or \"ERROR <message>\" on a single line." << std::endl
+            << "  STATS\\n" << std::endl
+            << "      Replies the histogram of the time from the request line to the reply, one line per bucket,"
+            << std::endl
+            << "      terminated by \"END\"." << std::endl;
+}
+
+/**
+ * Counts request latencies in power-of-two buckets of microseconds.
+ */
+class LatencyHistogram {
+  public:
+    void record(std::chrono::nanoseconds latency) {
+      const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+      const std::size_t bucket = std::bit_width(static_cast<std::uint64_t>(std::max<decltype(micros)>(micros, 0)));
+      counts[std::min(bucket, num_buckets - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Prints one line per non-empty bucket, e.g. "< 64us: 1234".
+    void print(std::ostream &out) const {
+      for (std::size_t i = 0; i < num_buckets; ++i) {
+        const std::uint64_t count = counts[i].load(std::memory_order_relaxed);
+        if (count == 0) {
+          continue;
+        }
+        if (i + 1 < num_buckets) {
+          out << "< " << (std::uint64_t(1) << i) << "us: " << count << "\n";
+        } else {
+          out << ">= " << (std::uint64_t(1) << (i - 1)) << "us: " << count << "\n";
+        }
+      }
+    }
+
+  private:
+    // Bucket i counts latencies below 2^i us, the last one counts everything else.
+    static constexpr std::size_t num_buckets = 24;
+    std::array<std::atomic<std::uint64_t>, num_buckets> counts{};
+};
+
+/**
+ * Buffered reading and writing of the request protocol on a connected, non-blocking socket.
+ *
+ * Every read and write waits at most until the deadline of the current request, so that a slow or stalled
+ * client cannot keep a worker busy.
+ */
+class Connection {
+  public:
+    explicit Connection(int fd) : fd(fd) {}
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    ~Connection() {
+      close(fd);
+    }
+
+    int descriptor() const {
+      return fd;
+    }
+
+    void set_deadline(std::chrono::steady_clock::time_point time) {
+      deadline = time;
+    }
+
+    // Whether the client already sent (part of) another request.
+    bool has_pending() const {
+      return !pending.empty();
+    }
+
+    // Reads the next line without its newline. Returns false on EOF, errors, timeouts or overlong lines.
+    bool read_line(std::string &line) {
+      std::size_t newline;
+      while ((newline = pending.find('\n')) == std::string::npos) {
+        if (pending.size() > max_header_size || !fill()) {
+          return false;
+        }
+      }
+      line.assign(pending, 0, newline);
+      pending.erase(0, newline + 1);
+      return true;
+    }
+
+    // Reads exactly `size` bytes into `data`, reusing its capacity.
+    bool read_bytes(std::size_t size, std::string &data) {
+      data.assign(pending, 0, std::min(size, pending.size()));
+      pending.erase(0, data.size());
+      std::size_t received = data.size();
+      data.resize(size);
+      while (received < size) {
+        const std::size_t n = receive(data.data() + received, size - received);
+        if (n == 0) {
+          return false;
+        }
+        received += n;
+      }
+      return true;
+    }
+
+    bool write(std::string_view data) {
+      while (!data.empty()) {
+        const ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+          data.remove_prefix(n);
+        } else if (n == 0 || (errno != EINTR && (errno != EAGAIN || !wait(POLLOUT)))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  private:
+    bool fill() {
+      char chunk[4096];
+      const std::size_t n = receive(chunk, sizeof(chunk));
+      pending.append(chunk, n);
+      return n > 0;
+    }
+
+    // Receives up to `size` bytes. Returns 0 on EOF, errors and timeouts.
+    std::size_t receive(char *data, std::size_t size) {
+      while (true) {
+        const ssize_t n = recv(fd, data, size, 0);
+        if (n >= 0) {
+          return n;
+        }
+        if (errno != EINTR && (errno != EAGAIN || !wait(POLLIN))) {
+          return 0;
+        }
+      }
+    }
+
+    // Waits until the socket is ready for `events`. Returns false once the deadline has passed.
+    bool wait(short events) const {
+      while (true) {
+        const auto remaining
+            = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+          return false;
+        }
+        pollfd request = {.fd = fd, .events = events, .revents = 0};
+        const int n = poll(&request, 1, static_cast<int>(std::min<decltype(remaining)>(remaining, INT_MAX)));
+        if (n >= 0 || errno != EINTR) {
+          return n > 0;
+        }
+      }
+    }
+
+    const int fd;
+    std::string pending;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+/**
+ * Accepts connections and serves their requests on a fixed number of worker threads.
+ *
+ * A worker serves a single request and then hands the connection back, so idle clients don't occupy any
+ * worker. The accepting thread polls the idle connections and queues those that send another request. Once
+ * the queue of connections waiting for a worker is full, no more connections are accepted and new clients
+ * wait in the listen backlog of the socket instead.
+ */
+class Daemon {
+  public:
+    Daemon(const std::vector<SpecLibrary> &libraries, int listen_fd, std::size_t max_queue,
+        std::chrono::milliseconds timeout)
+        : libraries(libraries), listen_fd(listen_fd), wake_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+          max_queue(max_queue), timeout(timeout) {}
+
+    Daemon(const Daemon &) = delete;
+    Daemon &operator=(const Daemon &) = delete;
+
+    ~Daemon() {
+      close(wake_fd);
+    }
+
+    void run(unsigned jobs) {
+      std::vector<std::jthread> workers;
+      for (unsigned i = 0; i < jobs; ++i) {
+        workers.emplace_back([this] { work(); });
+      }
+      std::vector<pollfd> polled;
+      while (true) {
+        polled.clear();
+        {
+          std::lock_guard lock(mutex);
+          if (stopping) {
+            break;
+          }
+          polled.push_back({.fd = wake_fd, .events = POLLIN, .revents = 0});
+          if (queue.size() < max_queue) {
+            if (!accept_paused) {
+              polled.push_back({.fd = listen_fd, .events = POLLIN, .revents = 0});
+            }
+            for (const int fd : idle) {
+              polled.push_back({.fd = fd, .events = POLLIN, .revents = 0});
+            }
+          }
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          stop();
+          break;
+        }
+        for (const pollfd &entry : polled) {
+          if (entry.revents == 0) {
+            continue;
+          }
+          if (entry.fd == wake_fd) {
+            std::uint64_t count;
+            [[maybe_unused]] const ssize_t n = read(wake_fd, &count, sizeof(count));
+          } else if (entry.fd == listen_fd) {
+            accept_connection();
+          } else {
+            // The client sent another request, or closed the connection.
+            {
+              std::lock_guard lock(mutex);
+              idle.erase(entry.fd);
+              queue.push_back(entry.fd);
+            }
+            queue_not_empty.notify_one();
+          }
+        }
+      }
+      workers.clear();
+      queue.clear();
+      idle.clear();
+      connections.clear();
+    }
+
+    // Stops accepting connections and ends all open ones. Can be called from any thread.
+    void stop() {
+      {
+        std::lock_guard lock(mutex);
+        if (stopping) {
+          return;
+        }
+        stopping = true;
+        for (const int fd : active) {
+          shutdown(fd, SHUT_RD);
+        }
+      }
+      wake();
+      queue_not_empty.notify_all();
+    }
+
+    const LatencyHistogram &latencies() const {
+      return histogram;
+    }
+
+  private:
+    void accept_connection() {
+      const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+      const int error = fd < 0 ? errno : 0;
+      if (fd < 0 && error != EINTR && error != EAGAIN && error != ECONNABORTED && error != EMFILE && error != ENFILE
+          && error != ENOBUFS && error != ENOMEM) {
+        stop();
+        return;
+      }
+      std::lock_guard lock(mutex);
+      if (fd >= 0) {
+        connections.emplace(fd, std::make_unique<Connection>(fd));
+        idle.insert(fd);
+      } else if (error != EINTR && error != EAGAIN && error != ECONNABORTED) {
+        // Out of file descriptors or memory, try again once a connection has been closed.
+        accept_paused = true;
+      }
+    }
+
+    // Wakes up the accepting thread, so that it polls the current set of connections.
+    void wake() {
+      const std::uint64_t count = 1;
+      [[maybe_unused]] const ssize_t n = ::write(wake_fd, &count, sizeof(count));
+    }
+
+    void work() {
+      std::string document;
+      while (true) {
+        Connection *connection;
+        {
+          std::unique_lock lock(mutex);
+          queue_not_empty.wait(lock, [this] { return stopping || !queue.empty(); });
+          if (stopping) {
+            return;
+          }
+          const int fd = queue.front();
+          queue.pop_front();
+          active.insert(fd);
+          connection = connections.at(fd).get();
+        }
+        // The queue may have been full, so that the accepting thread has to poll again.
+        wake();
+        const bool keep = serve(*connection, document);
+        bool pipelined = false;
+        {
+          std::lock_guard lock(mutex);
+          const int fd = connection->descriptor();
+          active.erase(fd);
+          if (!keep || stopping) {
+            connections.erase(fd);
+            accept_paused = false;
+          } else if (connection->has_pending()) {
+            // The next request has already been received, so polling the socket would miss it.
+            queue.push_back(fd);
+            pipelined = true;
+          } else {
+            idle.insert(fd);
+          }
+        }
+        if (pipelined) {
+          queue_not_empty.notify_one();
+        }
+        wake();
+      }
+    }
+
+    // Serves a single request. Returns false if the connection has to be closed.
+    bool serve(Connection &connection, std::string &document) {
+      connection.set_deadline(std::chrono::steady_clock::now() + timeout);
+      std::string header;
+      if (!connection.read_line(header)) {
+        return false;
+      }
+      std::istringstream request(header);
+      std::string command;
+      request >> command;
+      if (command == "VALIDATE") {
+        // The latency includes receiving the document.
+        const auto start = std::chrono::steady_clock::now();
+        std::string type_name;
+        std::size_t size;
+        if (!(request >> type_name >> size) || size > max_document_size) {
+          connection.write("ERROR Invalid request\n");
+          return false;
+        }
+        if (!connection.read_bytes(size, document)) {
+          return false;
+        }
+        if (!connection.write(validate(type_name, document))) {
+          return false;
+        }
+        histogram.record(std::chrono::steady_clock::now() - start);
+        return true;
+      }
+      if (command == "STATS") {
+        std::ostringstream reply;
+        histogram.print(reply);
+        reply << "END\n";
+        return connection.write(reply.str());
+      }
+      connection.write("ERROR Unknown command\n");
+      return false;
+    }
+
+    // Validates `document` against the first library that knows `type_name` and renders the reply. The
+    // document is parsed into a node like in the default mode of yavl-validate-sample, so aliases and
+    // duplicate items are handled the same way.
+    std::string validate(std::string_view type_name, const std::string &document) const {
+      for (const auto &library : libraries) {
+        const std::size_t type_id = library.symbols->get_type_id(type_name.data(), type_name.size());
+        if (type_id == YAVL::npos) {
+          continue;
+        }
+        YAVL::ValidationReport report;
+        library.symbols->validate_by_id({document.data(), document.size()}, type_id, &report);
+        if (report.ok) {
+          return "OK\n";
+        }
+        std::string message = report.message;
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        return "FAILED " + message + "\n";
+      }
+      return "ERROR Invalid type: \"" + std::string(type_name) + "\"\n";
+    }
+
+    const std::vector<SpecLibrary> &libraries;
+    const int listen_fd;
+    const int wake_fd;
+    const std::size_t max_queue;
+    const std::chrono::milliseconds timeout;
+    LatencyHistogram histogram;
+
+    std::mutex mutex;
+    std::condition_variable queue_not_empty;
+    // All open connections. Each of them is either idle, queued or active.
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::unordered_set<int> idle;
+    std::deque<int> queue;
+    std::unordered_set<int> active;
+    bool accept_paused = false;
+    bool stopping = false;
+};
+
+// Parses a positive number. Unlike std::stoul, this rejects signs and trailing characters.
+template <typename T>
+bool parse_count(std::string_view value, T &count) {
+  const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), count);
+  return error == std::errc() && end == value.data() + value.size() && count > 0;
+}
+
+int listen_on(const std::string &path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Error: Socket path \"" << path << "\" is too long" << std::endl;
+    return -1;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  // Remove a socket left behind by a previous run, but never any other kind of file.
+  if (struct stat info; stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    unlink(path.c_str());
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd < 0 || bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+      || listen(fd, SOMAXCONN) != 0) {
+    std::cerr << "Error: Unable to listen on \"" << path << "\": " << std::strerror(errno) << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char **argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t max_queue = 64;
+  unsigned timeout = 10;
+  int i = 1;
+  for (; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    if (arg == "--jobs") {
+      if (!parse_count(argv[i + 1], jobs)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--queue") {
+      if (!parse_count(argv[i + 1], max_queue)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--timeout") {
+      if (!parse_count(argv[i + 1], timeout)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else {
+      break;
+    }
+  }
+  if (argc - i < 2) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  const std::string socket_path = argv[i];
+
+  std::vector<SpecLibrary> libraries;
+  for (++i; i < argc; ++i) {
+    libraries.emplace_back(argv[i]);
+    if (!libraries.back().symbols) {
+      std::cerr << "Error: " << libraries.back().error << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // SIGINT and SIGTERM are only handled by the signal thread below, which shuts the daemon down cleanly.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  const int listen_fd = listen_on(socket_path);
+  if (listen_fd < 0) {
+    return EXIT_FAILURE;
+  }
+  Daemon daemon(libraries, listen_fd, max_queue, std::chrono::seconds(timeout));
+  std::jthread signal_thread([&] {
+    int signal;
+    sigwait(&signals, &signal);
+    daemon.stop();
+  });
+  std::cerr << "Listening on \"" << socket_path << "\" with " << jobs << " workers" << std::endl;
+  daemon.run(jobs);
+  // Wakes up the signal thread in case the daemon stopped on its own.
+  pthread_kill(signal_thread.native_handle(), SIGTERM);
+  signal_thread.join();
+
+  close(listen_fd);
+  unlink(socket_path.c_str());
+  std::cerr << "Request latencies:" << std::endl;
+  daemon.latencies().print(std::cerr);
+  return EXIT_SUCCESS;
+}
@@ -5,6 +5,7 @@ from typing import Any, TextIO, Optional
 import subprocess
 import yaml
 import os
+import re
 from enum import Enum
 
 
@@ -19,6 +20,14 @@ class CompilerOptions:
     emit_readers: bool = True
     emit_writers: bool = True
     emit_validator: bool = True
+    emit_binary: bool = True
+    pmr: bool = False
+
+
+# The containers that are replaced by their counterparts with a polymorphic allocator in --pmr mode.
+PMR_CONTAINERS = re.compile(
+    r"\b(std|tsl)::(string|vector|set|map|unordered_set|unordered_map|ordered_set|ordered_map)\b"
+)
 
 
 class TypeKind(Enum):
@@ -75,7 +84,12 @@ class CodeGenerator:
         spec = self.spec
         self.writeln("#pragma once")
         self.writeln()
-        if options.emit_readers or options.emit_writers or options.emit_validator:
+        if (
+            options.emit_readers
+            or options.emit_writers
+            or options.emit_validator
+            or options.emit_binary
+        ):
             self.writeln('#include "yavl-cpp/convert.h"')
             self.writeln()
         if "ExtraIncludes" in spec:
@@ -98,16 +112,27 @@ class CodeGenerator:
             if options.emit_declarations:
                 self.emit_map_declaration(type_name, type_info)
             if options.emit_readers:
+                self.emit_map_key_index(type_name, type_info)
+                self.emit_map_traits(type_name, type_info)
+                self.emit_map_fields(type_name, type_info)
                 self.emit_map_reader(type_name, type_info)
             if options.emit_writers:
                 self.emit_map_writer(type_name, type_info)
+            if options.emit_binary:
+                self.emit_binary_schema(type_name, type_info)
+                self.emit_map_binary_codec(type_name, type_info)
         elif type_kind == TypeKind.ENUM:
             if options.emit_declarations:
                 self.emit_enum_declaration(type_name, type_info)
+            if options.emit_readers or options.emit_writers:
+                self.emit_enum_traits(type_name, type_info)
             if options.emit_readers:
+                self.emit_enum_key_index(type_name, type_info)
                 self.emit_enum_reader(type_name, type_info)
             if options.emit_writers:
                 self.emit_enum_writer(type_name, type_info)
+            if options.emit_binary:
+                self.emit_binary_schema(type_name, type_info)
         else:
             if options.emit_declarations:
                 self.emit_alias(type_name, type_info)
@@ -127,7 +152,7 @@ class CodeGenerator:
     def get_map_field_type_identifier(
         self, simple_name, parent_type_name, parent_type_info
     ):
-        return self.get_type_identifier(simple_name)
+        return self.get_container_identifier(self.get_type_identifier(simple_name))
 
     def get_map_field_identifier(self, simple_name, parent_type_name, parent_type_info):
         return self.get_name_identifier(simple_name)
@@ -143,8 +168,22 @@ class CodeGenerator:
     def get_alias_identifier(self, simple_name):
         return self.get_type_identifier(simple_name)
 
+    def get_container_identifier(self, type_identifier):
+        # Switches the containers in a type to polymorphic allocators in --pmr mode.
+        if not self.options.pmr:
+            return type_identifier
+        return PMR_CONTAINERS.sub(
+            lambda match: "{}::pmr::{}".format(
+                "std" if match.group(1) == "std" else "YAVL", match.group(2)
+            ),
+            type_identifier,
+        )
+
     def emit_map_declaration(self, type_name, type_info):
-        self.writeln("struct {} {{".format(self.get_map_type_identifier(type_name)))
+        map_type_name = self.get_map_type_identifier(type_name)
+        self.writeln("struct {} {{".format(map_type_name))
+        if self.options.pmr:
+            self.emit_map_allocator_constructors(type_name, type_info)
         for field_name, field_type in type_info.items():
             field_name = self.get_map_field_identifier(field_name, type_name, type_info)
             field_type = self.get_map_field_type_identifier(
@@ -161,52 +200,333 @@ class CodeGenerator:
         self.writeln("};")
         self.writeln()
 
-    def emit_map_reader(self, type_name, type_info):
+    def emit_map_allocator_constructors(self, type_name, type_info):
+        # Makes the map type allocator-aware, so that containers of it pass their allocator on
+        # to its fields.
+        map_type_name = self.get_map_type_identifier(type_name)
+        fields = []
+        arrays = []
+        for field_name, field_type in type_info.items():
+            field_name = self.get_map_field_identifier(field_name, type_name, type_info)
+            field_type = self.get_map_field_type_identifier(
+                field_type, type_name, type_info
+            )
+            if self.is_array_type(field_type):
+                arrays.append(field_name)
+            else:
+                fields.append(field_name)
+        self.writeln("using allocator_type = std::pmr::polymorphic_allocator<>;")
+        self.writeln(indent=False)
+        self.writeln("{}() = default;".format(map_type_name))
+        self.writeln(indent=False)
+        self.emit_allocator_constructor(
+            "explicit {}(".format(map_type_name), None, fields, arrays
+        )
+        self.writeln(indent=False)
+        self.emit_allocator_constructor(
+            "{0}(const {0} &".format(map_type_name), "other.{}", fields, arrays
+        )
+        self.writeln(indent=False)
+        self.emit_allocator_constructor(
+            "{0}({0} &&".format(map_type_name), "std::move(other.{})", fields, arrays
+        )
+        if fields or arrays:
+            self.writeln(indent=False)
+
+    def emit_allocator_constructor(self, prefix, source, fields, arrays):
+        parameters = []
+        if source is not None:
+            parameters.append(prefix + ("other" if fields or arrays else ""))
+            prefix = ""
+        parameters.append(
+            prefix + "const allocator_type &" + ("allocator" if fields or arrays else "")
+        )
+        body = " {}" if not arrays else " {"
+        if not fields:
+            self.writeln("{}){}".format(", ".join(parameters), body), auto_indent=False)
+        else:
+            self.writeln("{})".format(", ".join(parameters)))
+            self.indent(2)
+            for i, field_name in enumerate(fields):
+                arguments = "allocator"
+                if source is not None:
+                    arguments += ", " + source.format(field_name)
+                self.writeln(
+                    "{} {}(YAVL::make_field<decltype({})>({})){}".format(
+                        ":" if i == 0 else " ",
+                        field_name,
+                        field_name,
+                        arguments,
+                        "," if i < len(fields) - 1 else body,
+                    ),
+                    auto_indent=False,
+                )
+            self.unindent(2)
+        if arrays:
+            self.indent()
+            for field_name in arrays:
+                arguments = field_name + ", allocator"
+                if source is not None:
+                    arguments += ", " + source.format(field_name)
+                self.writeln("YAVL::construct_array({});".format(arguments))
+            self.writeln("}")
+
+    def is_array_type(self, type_identifier):
+        # C arrays can't be initialized from a value, so aliases of them have to be resolved.
+        seen = set()
+        while "[" not in type_identifier:
+            if type_identifier in seen:
+                return False
+            seen.add(type_identifier)
+            for type_name, type_info in self.spec["Types"].items():
+                if (
+                    self.get_type_kind(type_name, type_info) == TypeKind.ALIAS
+                    and self.get_alias_identifier(type_name) == type_identifier
+                ):
+                    type_identifier = self.get_identifier(type_info)
+                    break
+            else:
+                return False
+        return True
+
+    def get_char_literal(self, char):
+        if char.isalnum() or char == "_":
+            return "'{}'".format(char)
+        return str(ord(char))
+
+    def emit_string_dispatch(self, variable, keys):
+        # Emits a decision tree that maps `variable` to the index of the
+        # matching key. Every level switches on a single character, so a
+        # lookup costs at most one full string comparison at the leaf.
+        if len(keys) == 1:
+            index, key = keys[0]
+            self.writeln(
+                'return {} == "{}" ? {} : YAVL::npos;'.format(variable, key, index)
+            )
+            return
+        length = len(keys[0][1])
+        best_position = None
+        best_groups = None
+        for position in range(length):
+            groups = {}
+            for index, key in keys:
+                groups.setdefault(key[position], []).append((index, key))
+            if best_groups is None or len(groups) > len(best_groups):
+                best_position = position
+                best_groups = groups
+        if best_groups is None or len(best_groups) == 1:
+            self.emit_string_dispatch(variable, keys[:1])
+            return
+        self.writeln("switch ({}[{}]) {{".format(variable, best_position))
+        for char, group in sorted(best_groups.items()):
+            self.writeln("case {}:".format(self.get_char_literal(char)))
+            self.indent()
+            self.emit_string_dispatch(variable, group)
+            self.unindent()
+        self.writeln("}")
+        self.writeln("break;")
+
+    def emit_string_lookup(self, variable, keys):
+        # Emits the body of a function that returns the index of `variable`
+        # in `keys`, or YAVL::npos. Keys are told apart by their length
+        # first, then by emit_string_dispatch().
+        groups = {}
+        for index, key in enumerate(keys):
+            groups.setdefault(len(key), []).append((index, key))
+        if groups:
+            self.writeln("switch ({}.size()) {{".format(variable))
+            for length, group in sorted(groups.items()):
+                self.writeln("case {}:".format(length))
+                self.indent()
+                self.emit_string_dispatch(variable, group)
+                self.unindent()
+            self.writeln("}")
+        self.writeln("return YAVL::npos;")
+
+    def emit_key_index(self, type_identifier, keys):
+        self.writeln("template<>")
         self.writeln(
-            "inline void operator>>(const YAML::Node &input, {} &output) {{".format(
-                self.get_map_type_identifier(type_name)
+            "inline std::size_t YAVL::key_index<{}>(std::string_view key) {{".format(
+                type_identifier
             )
         )
-        self.writeln("const std::unordered_map<std::string, bool> keys = {")
-        num_fields = len(type_info)
-        for i, (field_name, field_type) in enumerate(type_info.items()):
-            field_name = self.get_map_field_identifier(field_name, type_name, type_info)
+        self.emit_string_lookup("key", keys)
+        self.writeln("}")
+        self.writeln()
+
+    def emit_map_key_index(self, type_name, type_info):
+        self.emit_key_index(
+            self.get_map_type_identifier(type_name),
+            [
+                self.get_map_field_identifier(field_name, type_name, type_info)
+                for field_name in type_info
+            ],
+        )
+
+    def emit_map_traits(self, type_name, type_info):
+        map_type_name = self.get_map_type_identifier(type_name)
+        field_names = []
+        required = []
+        for field_name, field_type in type_info.items():
+            field_names.append(
+                self.get_map_field_identifier(field_name, type_name, type_info)
+            )
             field_type = self.get_map_field_type_identifier(
                 field_type, type_name, type_info
             )
-            is_required = not field_type.startswith("std::optional<")
-            is_last = i == (num_fields - 1)
+            required.append(not self.is_optional_field_type(field_type))
+        num_fields = len(field_names)
+        self.writeln("template<>")
+        self.writeln("struct YAVL::map_traits<{}> {{".format(map_type_name))
+        self.writeln('static constexpr const char *name = "{}";'.format(map_type_name))
+        self.writeln(
+            "static constexpr std::array<std::string_view, {}> keys = {{{}}};".format(
+                num_fields, ", ".join('"{}"'.format(name) for name in field_names)
+            )
+        )
+        self.writeln(
+            "static constexpr std::array<bool, {}> required = {{{}}};".format(
+                num_fields,
+                ", ".join("true" if is_required else "false" for is_required in required),
+            )
+        )
+        self.writeln("static constexpr YAVL::TypeInfo info = {name, keys};")
+        self.writeln(indent=False)
+        self.writeln("template<typename F>")
+        self.writeln(
+            "static void visit({} &obj, std::size_t index, F &&f) {{".format(
+                map_type_name
+            )
+        )
+        if num_fields > 0:
+            self.writeln("switch (index) {")
+            for i, field_name in enumerate(field_names):
+                self.writeln("case {}:".format(i))
+                self.indent()
+                self.writeln("f(obj.{});".format(field_name))
+                self.writeln("break;")
+                self.unindent()
+            self.writeln("}")
+        self.writeln("}")
+        self.writeln(indent=False)
+        self.writeln("template<typename F>")
+        self.writeln("static void visit_type(std::size_t index, F &&f) {")
+        if num_fields > 0:
+            self.writeln("switch (index) {")
+            for i, field_name in enumerate(field_names):
+                self.writeln("case {}:".format(i))
+                self.indent()
+                self.writeln(
+                    "f(std::type_identity<decltype({}::{})>());".format(
+                        map_type_name, field_name
+                    )
+                )
+                self.writeln("break;")
+                self.unindent()
+            self.writeln("}")
+        self.writeln("}")
+        self.writeln("};")
+        self.writeln()
+
+    def emit_map_fields(self, type_name, type_info):
+        map_type_name = self.get_map_type_identifier(type_name)
+        self.writeln("template<>")
+        self.writeln("struct YAVL::fields<{}> {{".format(map_type_name))
+        for i, field_name in enumerate(type_info):
             self.writeln(
-                '{{"{}", {}}}{}'.format(
-                    field_name,
-                    "true" if is_required else "false",
-                    "," if not is_last else "",
+                "static constexpr auto {} = YAVL::FieldMask<{}>::of({});".format(
+                    self.get_map_field_identifier(field_name, type_name, type_info),
+                    map_type_name,
+                    i,
                 )
             )
         self.writeln("};")
-        self.writeln("for (const auto &[key, is_required] : keys) {")
-        self.writeln("if (is_required && !input[key]) {")
+        self.writeln()
+
+    def is_optional_field_type(self, field_type):
+        return field_type.startswith("std::optional<")
+
+    def emit_map_reader(self, type_name, type_info):
+        map_type_name = self.get_map_type_identifier(type_name)
+        self.writeln("template<>")
+        self.writeln("struct YAVL::decoder<{}> {{".format(map_type_name))
         self.writeln(
-            'throw YAVL::MissingKeyException("{}", key);'.format(
-                self.get_map_type_identifier(type_name)
+            "static YAVL::Status decode(const YAML::Node &input, {} &output) {{".format(
+                map_type_name
+            )
+        )
+        self.writeln("if (!input.IsMap() && !input.IsNull()) {")
+        self.writeln(
+            "return YAVL::Status::bad_conversion(input, YAVL::map_traits<{}>::info);".format(
+                map_type_name
             )
         )
         self.writeln("}")
-        self.writeln("}")
+        num_fields = len(type_info)
+        self.writeln("std::bitset<{}> found;".format(num_fields))
+        self.writeln("std::optional<YAML::Node> superfluous_key;")
         self.writeln("for (const auto &it : input) {")
-        self.writeln("const std::string key = it.first.as<std::string>();")
-        self.writeln("if (!keys.contains(key)) {")
+        self.writeln("if (!it.first.IsScalar()) {")
+        self.writeln("return YAVL::Status::bad_conversion(it.first.Mark());")
+        self.writeln("}")
+        self.writeln("const std::string &key = it.first.Scalar();")
         self.writeln(
-            'throw YAVL::SuperfluousKeyException("{}", key);'.format(
-                self.get_map_type_identifier(type_name)
-            )
+            "const std::size_t index = YAVL::key_index<{}>(key);".format(map_type_name)
         )
+        self.writeln("if (index == YAVL::npos) {")
+        self.writeln("if (!superfluous_key) {")
+        self.writeln("superfluous_key = it.first;")
         self.writeln("}")
+        self.writeln("continue;")
         self.writeln("}")
-        for field_name in type_info:
+        self.writeln("if (found.test(index)) {")
+        self.writeln("return YAVL::Status::duplicate_map_item(it.first.Mark());")
+        self.writeln("}")
+        self.writeln("found.set(index);")
+        self.writeln("YAVL::Status status;")
+        if num_fields > 0:
+            self.writeln("switch (index) {")
+            for i, field_name in enumerate(type_info):
+                field_name = self.get_map_field_identifier(
+                    field_name, type_name, type_info
+                )
+                self.writeln("case {}:".format(i))
+                self.indent()
+                self.writeln(
+                    "status = YAVL::decode(it.second, output.{});".format(field_name)
+                )
+                self.writeln("break;")
+                self.unindent()
+            self.writeln("}")
+        self.writeln("if (!status) {")
+        self.writeln("return status;")
+        self.writeln("}")
+        self.writeln("}")
+        for i, (field_name, field_type) in enumerate(type_info.items()):
             field_name = self.get_map_field_identifier(field_name, type_name, type_info)
-            self.writeln('input["{0}"] >> output.{0};'.format(field_name))
+            field_type = self.get_map_field_type_identifier(
+                field_type, type_name, type_info
+            )
+            self.writeln("if (!found.test({})) {{".format(i))
+            if self.is_optional_field_type(field_type):
+                self.writeln("output.{} = std::nullopt;".format(field_name))
+            else:
+                self.writeln(
+                    "return YAVL::Status::missing_key(YAVL::map_traits<{}>::info, {}, input.Mark());".format(
+                        map_type_name, i
+                    )
+                )
+            self.writeln("}")
+        self.writeln("if (superfluous_key) {")
+        self.writeln(
+            "return YAVL::Status::superfluous_key(YAVL::map_traits<{}>::info, superfluous_key->Scalar(), superfluous_key->Mark());".format(
+                map_type_name
+            )
+        )
+        self.writeln("}")
+        self.writeln("return YAVL::Status();")
         self.writeln("}")
+        self.writeln("};")
         self.writeln()
 
     def emit_map_writer(self, type_name, type_info):
@@ -235,57 +555,179 @@ class CodeGenerator:
         self.writeln("};")
         self.writeln()
 
+    def emit_enum_key_index(self, type_name, type_info):
+        self.emit_key_index(
+            self.get_enum_type_identifier(type_name),
+            [
+                self.get_enum_choice_identifier(choice, type_name, type_info)
+                for choice in type_info
+            ],
+        )
+
+    def emit_enum_traits(self, type_name, type_info):
+        enum_type_name = self.get_enum_type_identifier(type_name)
+        choices = [
+            self.get_enum_choice_identifier(choice, type_name, type_info)
+            for choice in type_info
+        ]
+        self.writeln("template<>")
+        self.writeln("struct YAVL::enum_traits<{}> {{".format(enum_type_name))
+        self.writeln('static constexpr const char *name = "{}";'.format(enum_type_name))
+        self.writeln(
+            "static constexpr std::array<std::string_view, {}> names = {{{}}};".format(
+                len(choices), ", ".join('"{}"'.format(choice) for choice in choices)
+            )
+        )
+        self.writeln("static constexpr YAVL::TypeInfo info = {name, names};")
+        self.writeln("};")
+        self.writeln()
+
     def emit_enum_reader(self, type_name, type_info):
+        enum_type_name = self.get_enum_type_identifier(type_name)
+        self.writeln("template<>")
+        self.writeln("struct YAVL::decoder<{}> {{".format(enum_type_name))
         self.writeln(
-            "inline void operator>>(const YAML::Node &input, {} &output) {{".format(
-                self.get_enum_type_identifier(type_name)
+            "static YAVL::Status decode(const YAML::Node &input, {} &output) {{".format(
+                enum_type_name
             )
         )
-        self.writeln("std::string tmp;")
-        self.writeln("input >> tmp;")
-        num_choices = len(type_info)
-        for i, choice in enumerate(type_info):
-            choice = self.get_enum_choice_identifier(choice, type_name, type_info)
-            is_first = i == 0
-            is_last = i == (num_choices - 1)
-            self.writeln('if (tmp == "{}") {{'.format(choice), indent=is_first)
-            self.writeln("output = {};".format(choice))
-            self.write("}")
-            self.write(" else ", indent=False)
-        self.writeln("{", indent=False)
         self.writeln(
-            'throw YAVL::BadConversionException(input, "{}");'.format(
-                self.get_enum_type_identifier(type_name)
+            "if (const std::optional<{0}> value = YAVL::from_string_view<{0}>(input.Scalar())) {{".format(
+                enum_type_name
             )
         )
+        self.writeln("output = *value;")
+        self.writeln("return YAVL::Status();")
         self.writeln("}")
+        self.writeln(
+            "return YAVL::Status::bad_conversion(input, YAVL::enum_traits<{}>::info);".format(
+                enum_type_name
+            )
+        )
         self.writeln("}")
+        self.writeln("};")
         self.writeln()
 
     def emit_enum_writer(self, type_name, type_info):
+        enum_type_name = self.get_enum_type_identifier(type_name)
         self.writeln(
             "inline YAML::Emitter& operator<<(YAML::Emitter &output, const {} &input) {{".format(
-                self.get_enum_type_identifier(type_name)
+                enum_type_name
             )
         )
-        num_choices = len(type_info)
-        for i, choice in enumerate(type_info):
-            choice = self.get_enum_choice_identifier(choice, type_name, type_info)
-            is_first = i == 0
-            is_last = i == (num_choices - 1)
-            self.writeln("if (input == {}) {{".format(choice), indent=is_first)
-            self.writeln('output << "{}";'.format(choice))
-            self.write("}")
-            if not is_last:
-                self.write(" else ", indent=False)
+        self.writeln("const std::string_view name = YAVL::to_string_view(input);")
+        self.writeln("if (name.empty()) {")
+        self.writeln("// Not one of the choices, write the plain value to keep the output well-formed.")
+        self.writeln(
+            "return output << static_cast<std::underlying_type_t<{}>>(input);".format(
+                enum_type_name
+            )
+        )
+        self.writeln("}")
+        self.writeln("return output << std::string(name);")
+        self.writeln("}")
+        self.writeln()
+
+    def describe_type(self, type_name, type_info):
+        # Describes the parts of a type that its binary encoding depends on.
+        type_kind = self.get_type_kind(type_name, type_info)
+        if type_kind == TypeKind.MAP:
+            fields = ",".join(
+                "{}:{}".format(field_name, field_type)
+                for field_name, field_type in type_info.items()
+            )
+            description = "{}{{{}}}".format(type_name, fields)
+        elif type_kind == TypeKind.ENUM:
+            description = "{}({})".format(type_name, ",".join(map(str, type_info)))
+        else:
+            description = "{}={}".format(type_name, type_info)
+        return re.sub(r"\s+", "", description)
+
+    def get_binary_schema_hash(self, type_name):
+        # Hashes the descriptions of the type and of all the types of the spec it refers to, with
+        # 64 bit FNV-1a, so that the hash changes whenever the encoding of the type does.
+        types = self.spec["Types"]
+        referenced = set()
+        pending = [type_name]
+        while pending:
+            name = pending.pop()
+            if name in referenced:
+                continue
+            referenced.add(name)
+            info = types[name]
+            if isinstance(info, dict):
+                texts = [str(field_type) for field_type in info.values()]
+            elif isinstance(info, list):
+                texts = []
+            else:
+                texts = [str(info)]
+            for text in texts:
+                pending.extend(
+                    word
+                    for word in re.findall(r"[A-Za-z_]\w*", text)
+                    if word in types
+                )
+        schema = ";".join(
+            self.describe_type(name, types[name]) for name in sorted(referenced, key=str)
+        )
+        value = 0xCBF29CE484222325
+        for byte in schema.encode("utf-8"):
+            value = ((value ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+        return value
+
+    def emit_binary_schema(self, type_name, type_info):
+        if self.get_type_kind(type_name, type_info) == TypeKind.MAP:
+            type_identifier = self.get_map_type_identifier(type_name)
+        else:
+            type_identifier = self.get_enum_type_identifier(type_name)
+        self.writeln("template<>")
+        self.writeln("struct YAVL::binary_schema<{}> {{".format(type_identifier))
+        self.writeln(
+            "static constexpr std::uint64_t hash = 0x{:016x};".format(
+                self.get_binary_schema_hash(type_name)
+            )
+        )
+        self.writeln("};")
+        self.writeln()
+
+    def emit_map_binary_codec(self, type_name, type_info):
+        map_type_name = self.get_map_type_identifier(type_name)
+        field_names = [
+            self.get_map_field_identifier(field_name, type_name, type_info)
+            for field_name in type_info
+        ]
+        self.writeln("template<>")
+        self.writeln("struct YAVL::binary_codec<{}> {{".format(map_type_name))
+        self.writeln(
+            "static void write(const {} &input, YAVL::Buffer &output) {{".format(
+                map_type_name
+            )
+        )
+        for field_name in field_names:
+            self.writeln("YAVL::write_binary(input.{}, output);".format(field_name))
+        self.writeln("}")
         self.writeln(indent=False)
-        self.writeln("return output;")
+        self.writeln(
+            "static YAVL::Status read(YAVL::BinaryInput &input, {} &output) {{".format(
+                map_type_name
+            )
+        )
+        for field_name in field_names:
+            self.writeln(
+                "if (YAVL::Status status = YAVL::read_binary(input, output.{}); !status) {{".format(
+                    field_name
+                )
+            )
+            self.writeln("return status;")
+            self.writeln("}")
+        self.writeln("return YAVL::Status();")
         self.writeln("}")
+        self.writeln("};")
         self.writeln()
 
     def emit_alias(self, type_name, type_info):
         type_name = self.get_alias_identifier(type_name)
-        aliased_type = self.get_identifier(type_info)
+        aliased_type = self.get_container_identifier(self.get_identifier(type_info))
         bracket_pos = aliased_type.find("[")
         is_array_type = bracket_pos != -1
         if is_array_type:
@@ -296,44 +738,122 @@ class CodeGenerator:
             self.writeln("typedef {} {};".format(aliased_type, type_name))
         self.writeln()
 
-    def emit_validator(self):
-        self.writeln("inline std::vector<std::string> get_types() {")
-        self.writeln("return {")
-        types = self.spec["Types"]
-        num_types = len(types)
-        for i, (type_name, type_info) in enumerate(types.items()):
+    def get_type_identifiers(self):
+        type_identifiers = []
+        for type_name, type_info in self.spec["Types"].items():
             type_kind = self.get_type_kind(type_name, type_info)
             if type_kind == TypeKind.MAP:
-                type_name = self.get_map_type_identifier(type_name)
+                type_identifiers.append(self.get_map_type_identifier(type_name))
             elif type_kind == TypeKind.ENUM:
-                type_name = self.get_enum_type_identifier(type_name)
+                type_identifiers.append(self.get_enum_type_identifier(type_name))
             else:
-                type_name = self.get_alias_identifier(type_name)
-            is_last = i == (num_types - 1)
-            self.writeln('"{}"{}'.format(type_name, "," if not is_last else ""))
-        self.writeln("};")
+                type_identifiers.append(self.get_alias_identifier(type_name))
+        return type_identifiers
+
+    def emit_validator(self):
+        type_identifiers = self.get_type_identifiers()
+        # The ID of a type is its index in the spec.
+        self.writeln(
+            "inline constexpr std::array<std::string_view, {}> type_names = {{{}}};".format(
+                len(type_identifiers),
+                ", ".join('"{}"'.format(type_name) for type_name in type_identifiers),
+            )
+        )
+        self.writeln()
+        self.writeln("inline std::span<const std::string_view> get_types() {")
+        self.writeln("return type_names;")
+        self.writeln("}")
+        self.writeln()
+        self.writeln("inline std::size_t get_type_id(std::string_view type_name) {")
+        self.emit_string_lookup("type_name", type_identifiers)
         self.writeln("}")
         self.writeln()
+        self.emit_validate_function(
+            "validate", "const YAML::Node &node", "validate", "node"
+        )
+        self.emit_validate_many_function()
+        self.writeln("#ifdef __cpp_exceptions", indent=False)
+        self.emit_validate_function(
+            "validate_stream",
+            "std::istream &input",
+            "validate_stream",
+            "input",
+        )
+        self.emit_validate_stream_documents_function()
+        self.writeln("#endif // __cpp_exceptions", indent=False)
+
+    def emit_validate_function(
+        self, function_name, input_parameter, validate_function, input_name
+    ):
         self.writeln(
-            "inline std::tuple<bool, std::optional<std::string>> validate_simple(const YAML::Node &node, const std::string type_name) {"
+            "inline YAVL::validation_result {}_by_id({}, std::size_t type_id) {{".format(
+                function_name, input_parameter
+            )
         )
-        for i, (type_name, type_info) in enumerate(types.items()):
-            type_kind = self.get_type_kind(type_name, type_info)
-            if type_kind == TypeKind.MAP:
-                type_name = self.get_map_type_identifier(type_name)
-            elif type_kind == TypeKind.ENUM:
-                type_name = self.get_enum_type_identifier(type_name)
-            else:
-                type_name = self.get_alias_identifier(type_name)
-            is_first = i == 0
-            is_last = i == (num_types - 1)
-            self.writeln('if (type_name == "{}") {{'.format(type_name), indent=is_first)
-            self.writeln("return validate<{}>(node);".format(type_name))
-            self.write("}")
-            if not is_last:
-                self.write(" else ", indent=False)
-        self.writeln(indent=False)
-        self.writeln("return std::make_tuple(false, std::nullopt);")
+        type_identifiers = self.get_type_identifiers()
+        if type_identifiers:
+            self.writeln("switch (type_id) {")
+            for i, type_name in enumerate(type_identifiers):
+                self.writeln("case {}:".format(i))
+                self.indent()
+                self.writeln(
+                    "return {}<{}>({});".format(validate_function, type_name, input_name)
+                )
+                self.unindent()
+            self.writeln("}")
+        self.writeln('return {false, YAVL::Status::other("Unknown type")};')
+        self.writeln("}")
+        self.writeln()
+        self.writeln(
+            "inline YAVL::validation_result {}_simple({}, std::string_view type_name) {{".format(
+                function_name, input_parameter
+            )
+        )
+        self.writeln(
+            "return {}_by_id({}, get_type_id(type_name));".format(
+                function_name, input_name
+            )
+        )
+        self.writeln("}")
+        self.writeln()
+
+    def emit_validate_many_function(self):
+        self.writeln(
+            "inline void validate_many_by_id("
+            "const YAML::Node *nodes, std::size_t count, std::size_t type_id, YAVL::validation_result *results) {"
+        )
+        type_identifiers = self.get_type_identifiers()
+        if type_identifiers:
+            self.writeln("switch (type_id) {")
+            for i, type_name in enumerate(type_identifiers):
+                self.writeln("case {}:".format(i))
+                self.indent()
+                self.writeln("validate_many<{}>(nodes, count, results);".format(type_name))
+                self.writeln("return;")
+                self.unindent()
+            self.writeln("}")
+        self.writeln("for (std::size_t i = 0; i < count; ++i) {")
+        self.writeln('results[i] = {false, YAVL::Status::other("Unknown type")};')
+        self.writeln("}")
+        self.writeln("}")
+        self.writeln()
+
+    def emit_validate_stream_documents_function(self):
+        self.writeln("template<typename F>")
+        self.writeln(
+            "inline void validate_stream_documents_by_id(std::istream &input, std::size_t type_id, F &&f) {"
+        )
+        type_identifiers = self.get_type_identifiers()
+        if type_identifiers:
+            self.writeln("switch (type_id) {")
+            for i, type_name in enumerate(type_identifiers):
+                self.writeln("case {}:".format(i))
+                self.indent()
+                self.writeln("validate_stream_documents<{}>(input, f);".format(type_name))
+                self.writeln("return;")
+                self.unindent()
+            self.writeln("}")
+        self.writeln('f(0, YAVL::validation_result{false, YAVL::Status::other("Unknown type")});')
         self.writeln("}")
         self.writeln()
 
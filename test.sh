@@ -5,7 +5,26 @@ IFS=$'\n\t'
 
 cd "$(dirname "$0")"
 
-test_names="$(for f in examples/*.yaml ; do echo "$f" ; done | sed -E 's/^examples\///g;s/_spec.yaml$//g;s/_sample_correct.yaml//g;s/_sample_incorrect.yaml//g' | sort -u)"
+testdir="$(mktemp -d)"
+trap 'rm -rf "$testdir"' EXIT
+# validate.sh caches its libraries here instead of in the cache of the user.
+export YAVL_CACHE_DIR="$testdir/cache"
+
+test_names="$(for f in examples/*.yaml ; do echo "$f" ; done | sed -E 's/^examples\///g;s/_spec.yaml$//g;s/_sample_correct.yaml//g;s/_sample_incorrect(_[a-z0-9_]+)?\.yaml$//g' | sort -u)"
+
+echo '[ Check the code generator for methods that are defined twice ]'
+# Python silently keeps the last definition of a method, which leaves the earlier ones dead.
+python3 - src/yavl.py <<'EOF'
+import ast
+import sys
+
+tree = ast.parse(open(sys.argv[1]).read())
+for cls in (node for node in ast.walk(tree) if isinstance(node, ast.ClassDef)):
+    names = [node.name for node in cls.body if isinstance(node, ast.FunctionDef)]
+    duplicates = sorted({name for name in names if names.count(name) > 1})
+    if duplicates:
+        sys.exit("{} defines {} more than once".format(cls.name, ", ".join(duplicates)))
+EOF
 
 echo '[ Validate header generated from spec_spec.yaml ]'
 ./yavl-compile spec_spec.yaml /dev/stdout | diff - include/yavl-cpp/spec.h
@@ -17,6 +36,46 @@ output="$(./validate.sh 'spec_spec.yaml' 'spec_spec.yaml' SpecType 2>&1)" || {
   exit 1
 }
 
+echo '[ Test the cache of validate.sh ]'
+# Runs validate.sh on the custom code generator example in the cache test directory, and checks that
+# it compiles the library only if `expected` is "Compiling spec...".
+function check_cache() {
+  local expected="$1" output
+  output="$(./validate.sh "$testdir/cached/sample.yaml" "$testdir/cached/spec.yaml" TopType 2>&1)" || {
+    echo '[ Expected successful validation, but received error: ]'
+    echo "$output"
+    exit 1
+  }
+  if [ "$(echo "$output" | head -n 1)" != "$expected" ] ; then
+    echo "[ Expected validate.sh to start with \"$expected\", but received: ]"
+    echo "$output"
+    exit 1
+  fi
+}
+mkdir -p "$testdir/cached"
+cp examples/custom_code_generator_spec.yaml "$testdir/cached/spec.yaml"
+cp examples/custom_code_generator.py "$testdir/cached/"
+cp examples/custom_code_generator_sample_correct.yaml "$testdir/cached/sample.yaml"
+check_cache 'Compiling spec...'
+check_cache 'Using cached shared object...'
+echo '# edited' >> "$testdir/cached/spec.yaml"
+check_cache 'Compiling spec...'
+echo '# edited' >> "$testdir/cached/custom_code_generator.py"
+check_cache 'Compiling spec...'
+check_cache 'Using cached shared object...'
+
+# The programs in tests/ are compiled against the header generated from a spec.
+IFS=' ' read -r -a yaml_cpp_libs <<< "$(pkg-config --libs yaml-cpp)"
+
+# Any further arguments are passed on to yavl-compile.
+function build_test() {
+  local source="$1" spec="$2" binary="$3"
+  mkdir -p "$testdir/$binary"
+  ./yavl-compile "${@:4}" "$spec" "$testdir/$binary/spec.h" &&
+    g++ -std=c++20 -Wall -Werror -Wpedantic -Iinclude -Itests -I"$testdir/$binary" "$source" \
+      "${yaml_cpp_libs[@]}" -pthread -o "$testdir/$binary/test"
+}
+
 num_tests="$(echo "$test_names" | wc -l)"
 i=1
 set +e
@@ -27,17 +86,296 @@ for test_name in $test_names ; do
     echo "$output"
     exit 1
   }
-  output="$(./validate.sh 'examples/'"$test_name"'_sample_correct.yaml' 'examples/'"$test_name"'_spec.yaml' TopType 2>&1)" || {
+  for mode in '' '--stream' '--interpret' '--pmr' ; do
+    output="$(./validate.sh 'examples/'"$test_name"'_sample_correct.yaml' 'examples/'"$test_name"'_spec.yaml' TopType $mode 2>&1)" || {
+      echo '[ Expected successful validation, but received error: ]'
+      echo "$output"
+      exit 1
+    }
+  done
+  output="$(build_test tests/roundtrip.cpp 'examples/'"$test_name"'_spec.yaml' roundtrip 2>&1 &&
+    "$testdir"/roundtrip/test 'examples/'"$test_name"'_sample_correct.yaml' 2>&1)" || {
+    echo '[ Expected the sample to decode to the same value in every mode, but received: ]'
+    echo "$output"
+    exit 1
+  }
+  # An incorrect sample may start with a comment like "# expect: Duplicate key" naming the error it
+  # has to produce.
+  for incorrect_sample in 'examples/'"$test_name"'_sample_incorrect'*.yaml ; do
+    expected_error="$(sed -n '1s/^# expect: //p' "$incorrect_sample")"
+    compiled_error=''
+    for mode in '' '--stream' '--interpret' '--pmr' ; do
+      output="$(./validate.sh "$incorrect_sample" 'examples/'"$test_name"'_spec.yaml' TopType $mode 2>&1)" && {
+        echo "[ Expected validation error for $incorrect_sample, but validation succeeded: ]"
+        echo "$output"
+        exit 1
+      }
+      if [ -n "$expected_error" ] && [[ "$(echo "$output" | tail -n 1)" != *"$expected_error"* ]] ; then
+        echo "[ Expected an error containing \"$expected_error\" for $incorrect_sample, but received: ]"
+        echo "$output"
+        exit 1
+      fi
+      # The stream decoder, the interpreted spec and the --pmr types have to report exactly the same
+      # error as the compiled ones.
+      if [ "$mode" = '' ] ; then
+        compiled_error="$(echo "$output" | tail -n 1)"
+      elif [ "$(echo "$output" | tail -n 1)" != "$compiled_error" ] ; then
+        echo "[ Expected the same error as with the compiled spec for $incorrect_sample, but received: ]"
+        echo "$output"
+        exit 1
+      fi
+    done
+  done
+  i=$(( i + 1))
+done
+
+for mode in '' '--pmr' ; do
+  printf '[ Testing decoding into the same object again %s]\n' "${mode:+with $mode }"
+  output="$(build_test tests/recycle.cpp tests/recycle_spec.yaml recycle $mode 2>&1 && "$testdir"/recycle/test 2>&1)" || {
+    echo '[ Expected every decode into a used object to give the same value as into a new one, but received: ]'
+    echo "$output"
+    exit 1
+  }
+done
+
+for mode in '' '--pmr' ; do
+  printf '[ Testing lazy fields %s]\n' "${mode:+with $mode }"
+  output="$(build_test tests/lazy.cpp tests/lazy_spec.yaml lazy $mode 2>&1 && "$testdir"/lazy/test 2>&1)" || {
+    echo '[ Expected lazy fields to be decoded on first access into the same value, but received: ]'
+    echo "$output"
+    exit 1
+  }
+done
+
+printf '[ Testing the allocators of --pmr types ]\n'
+output="$(build_test tests/arena.cpp tests/arena_spec.yaml arena --pmr 2>&1 && "$testdir"/arena/test 2>&1)" || {
+  echo '[ Expected every string to allocate from the resource of its object, but received: ]'
+  echo "$output"
+  exit 1
+}
+
+# The spec has a vector of empty tuples, which yaml-cpp can't write.
+for mode in '' '--pmr' ; do
+  printf '[ Testing the binary encoding %s]\n' "${mode:+with $mode }"
+  output="$(build_test tests/binary.cpp tests/binary_spec.yaml binary --no-emit-writers $mode 2>&1 &&
+    "$testdir"/binary/test 2>&1)" || {
+    echo '[ Expected every value to survive a round trip through the binary encoding, but received: ]'
+    echo "$output"
+    exit 1
+  }
+done
+
+# The lazy fields are checked right away in every mode, also by the interpreted spec.
+printf 'name: foo\nregions: {eu: {limit: 1}, us: {limit: 2, note: bar}}\nnumbers: [1, 2]\n' > "$testdir/lazy_valid.yaml"
+printf 'name: foo\nregions: {eu: {limit: x}}\nnumbers: [1, 2]\n' > "$testdir/lazy_invalid.yaml"
+for mode in '' '--stream' '--interpret' '--pmr' ; do
+  printf '[ Testing validation of lazy fields %s]\n' "${mode:+with $mode }"
+  output="$(./validate.sh "$testdir/lazy_valid.yaml" tests/lazy_spec.yaml TopType $mode 2>&1)" || {
     echo '[ Expected successful validation, but received error: ]'
     echo "$output"
     exit 1
   }
-  output="$(./validate.sh 'examples/'"$test_name"'_sample_incorrect.yaml' 'examples/'"$test_name"'_spec.yaml' TopType 2>&1)" && {
-    echo '[ Expected validation error, but validation succeeded: ]'
+  output="$(./validate.sh "$testdir/lazy_invalid.yaml" tests/lazy_spec.yaml TopType $mode 2>&1)" && {
+    echo '[ Expected validation error for an invalid lazy field, but validation succeeded: ]'
     echo "$output"
     exit 1
   }
-  i=$(( i + 1))
+  if [[ "$(echo "$output" | tail -n 1)" != *'line 2, column 23: bad conversion' ]] ; then
+    echo '[ Expected a bad conversion of the lazy field, but received: ]'
+    echo "$output"
+    exit 1
+  fi
+done
+
+printf '[ Testing decoding only some fields ]\n'
+output="$(build_test tests/projection.cpp tests/projection_spec.yaml projection 2>&1 && "$testdir"/projection/test 2>&1)" || {
+  echo '[ Expected the skipped fields to be left untouched and the keys to be checked, but received: ]'
+  echo "$output"
+  exit 1
+}
+
+# Batch mode, checked against a library built from the simple example.
+printf '[ Testing batch mode ]\n'
+clidir="$testdir/cli"
+mkdir -p "$clidir/docs"
+./yavl-compile examples/simple_spec.yaml "$clidir/spec.h" &&
+  g++ -std=c++20 -shared -fPIC src/libtemplate.cpp -Iinclude -I"$clidir" "${yaml_cpp_libs[@]}" -o "$clidir/libspec.so" ||
+  exit 1
+cp examples/simple_sample_correct.yaml "$clidir/docs/valid.yaml"
+cp examples/simple_sample_incorrect.yaml "$clidir/docs/invalid.yaml"
+printf '%s\n' "$clidir/docs/valid.yaml" "$clidir/missing.yaml" > "$clidir/list"
+
+# Runs yavl-validate-sample with the given arguments and compares its exit status and output with the
+# expected ones.
+function check_cli() {
+  local expected_status="$1" expected_output="$2"
+  shift 2
+  local output status=0
+  output="$(./yavl-validate-sample "$@" 2>&1)" || status=$?
+  if [ "$status" -ne "$expected_status" ] || [ "$output" != "$expected_output" ] ; then
+    echo "[ Expected exit status $expected_status and the output below for: yavl-validate-sample $* ]"
+    echo "$expected_output"
+    echo "[ But received exit status $status and: ]"
+    echo "$output"
+    exit 1
+  fi
+}
+
+valid_output="$clidir/docs/valid.yaml: Validation successful!"
+invalid_output="$clidir/docs/invalid.yaml: Validation failed!
+  yaml-cpp: error at line 1, column 29: bad conversion"
+missing_output="$clidir/missing.yaml: Validation failed!
+  Unable to open file"
+for mode in '' '--stream' ; do
+  check_cli 0 "$valid_output
+1 of 1 documents are valid." $mode --batch "$clidir/libspec.so" TopType "$clidir/docs/valid.yaml"
+  check_cli 1 "$invalid_output
+$valid_output
+$missing_output
+1 of 3 documents are valid." $mode --jobs 1 --batch "$clidir/libspec.so" TopType "$clidir/docs/*.yaml" \
+    "$clidir/missing.yaml"
+  check_cli 1 "$invalid_output
+$valid_output
+$missing_output
+1 of 3 documents are valid." $mode --jobs "$(nproc)" --files-from "$clidir/list" --batch "$clidir/libspec.so" \
+    TopType "$clidir/docs/invalid.yaml"
+  check_cli 1 "$valid_output
+$missing_output
+1 of 2 documents are valid." $mode --files-from - --batch "$clidir/libspec.so" TopType < "$clidir/list"
+done
+check_cli 1 "$invalid_output
+$valid_output
+1 of 2 documents are valid." --interpret --batch examples/simple_spec.yaml TopType "$clidir/docs/*.yaml"
+check_cli 1 'Error: Unable to open "'"$clidir"'/missing-list"' \
+  --files-from "$clidir/missing-list" --batch "$clidir/libspec.so" TopType
+# --jobs takes any positive number of threads, also more than there are hardware threads.
+check_cli 0 "$valid_output
+1 of 1 documents are valid." --jobs "$(( $(getconf _NPROCESSORS_ONLN) + 1 ))" --batch "$clidir/libspec.so" TopType \
+  "$clidir/docs/valid.yaml"
+for jobs in 0 -1 +1 1x '' 18446744073709551617 ; do
+  output="$(./yavl-validate-sample --jobs "$jobs" --batch "$clidir/libspec.so" TopType \
+    "$clidir/docs/valid.yaml" 2>&1)" && {
+    echo "[ Expected --jobs $jobs to be rejected, but received: ]"
+    echo "$output"
+    exit 1
+  }
+  if [[ "$output" != 'Usage: '* ]] ; then
+    echo "[ Expected the usage for --jobs $jobs, but received: ]"
+    echo "$output"
+    exit 1
+  fi
+done
+
+printf '[ Testing multi-document streams ]\n'
+{
+  cat examples/simple_sample_correct.yaml
+  echo '---'
+  cat examples/simple_sample_incorrect.yaml
+  echo '---'
+  cat examples/simple_sample_correct.yaml
+} > "$clidir/multi.yaml"
+printf 'my_vec: [\n' > "$clidir/broken.yaml"
+multi_output='document 0: Validation successful!
+document 1: Validation failed!
+  yaml-cpp: error at line 6, column 29: bad conversion'
+check_cli 1 "$multi_output
+document 2: Validation successful!
+2 of 3 documents are valid." --all "$clidir/multi.yaml" "$clidir/libspec.so" TopType
+check_cli 1 "$multi_output
+1 of 2 documents are valid." --all --fail-fast "$clidir/multi.yaml" "$clidir/libspec.so" TopType
+check_cli 1 "$multi_output
+document 2: Validation successful!
+2 of 3 documents are valid." --all /dev/stdin "$clidir/libspec.so" TopType < "$clidir/multi.yaml"
+check_cli 0 'document 0: Validation successful!
+1 of 1 documents are valid.' --all "$clidir/docs/valid.yaml" "$clidir/libspec.so" TopType
+check_cli 1 'document 0: Validation failed!
+  yaml-cpp: error at line 2, column 1: end of sequence flow not found
+0 of 1 documents are valid.' --all "$clidir/broken.yaml" "$clidir/libspec.so" TopType
+check_cli 1 'Error: Unable to open "'"$clidir"'/missing.yaml"' --all "$clidir/missing.yaml" "$clidir/libspec.so" TopType
+
+printf '[ Testing yavl-validated ]\n'
+# A second library, whose types are found after those of the first one.
+printf 'ExtraIncludes: [<set>]\nTypes:\n    SetType:\n        items: std::set<int>\n' > "$clidir/set_spec.yaml"
+mkdir -p "$clidir/set"
+./yavl-compile "$clidir/set_spec.yaml" "$clidir/set/spec.h" &&
+  g++ -std=c++20 -shared -fPIC src/libtemplate.cpp -Iinclude -I"$clidir/set" "${yaml_cpp_libs[@]}" -o "$clidir/libset.so" ||
+  exit 1
+# A single worker shows whether idle and stalled connections keep it from serving the others.
+./yavl-validated --jobs 1 --timeout 1 "$clidir/yavl.sock" "$clidir/libspec.so" "$clidir/libset.so" \
+  2> "$clidir/daemon.log" &
+daemon_pid=$!
+for _ in $(seq 100) ; do
+  [ -S "$clidir/yavl.sock" ] && break
+  sleep 0.1
 done
+python3 - "$clidir/yavl.sock" examples/simple_sample_correct.yaml examples/simple_sample_incorrect.yaml <<'EOF'
+import socket
+import sys
+
+socket_path, valid, invalid = sys.argv[1], open(sys.argv[2], "rb").read(), open(sys.argv[3], "rb").read()
+
+
+def connect():
+    client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    client.settimeout(10)
+    client.connect(socket_path)
+    return client
+
+
+def request(client, data, expected):
+    client.sendall(data)
+    reply = b""
+    while not reply.startswith(expected) or (data.startswith(b"STATS") and not reply.endswith(b"END\n")):
+        chunk = client.recv(4096)
+        if not chunk:
+            break
+        reply += chunk
+    if not reply.startswith(expected):
+        sys.exit("Expected a reply starting with {!r} to {!r}, but received {!r}".format(expected, data[:40], reply))
+    return reply
+
+
+def validate(type_name, document):
+    return b"VALIDATE " + type_name + b" " + str(len(document)).encode() + b"\n" + document
+
+
+def expect_closed(client, description):
+    if client.recv(4096) != b"":
+        sys.exit("Expected the daemon to close the connection after " + description)
+
+
+idle = connect()
+stalled = connect()
+stalled.sendall(b"VALIDATE TopType 100\n")
+client = connect()
+request(client, validate(b"TopType", valid), b"OK\n")
+request(client, validate(b"TopType", invalid), b"FAILED yaml-cpp: error at line 1, column 29: bad conversion\n")
+request(client, validate(b"UnknownType", valid), b'ERROR Invalid type: "UnknownType"\n')
+# Documents are validated like in the default mode of yavl-validate-sample, not like with --stream.
+aliased = b'my_vec: [&a "x", *a]\nmy_enum: first_choice\nmy_int: 1\nmy_str: foo\n'
+request(client, validate(b"TopType", aliased), b"OK\n")
+request(client, validate(b"SetType", b"items: [1, 1]\n"), b"FAILED yaml-cpp: error at line 1, column 12: Duplicate key in set\n")
+# Pipelined requests are answered in order.
+request(client, validate(b"TopType", valid) * 2, b"OK\nOK\n")
+stats = request(client, b"STATS\n", b"< ")
+if sum(int(line.split(b": ")[1]) for line in stats.splitlines()[:-1]) != 7:
+    sys.exit("Expected the latencies of 7 validations, but received {!r}".format(stats))
+request(idle, validate(b"TopType", valid), b"OK\n")
+request(connect(), b"VALIDATE TopType " + str((64 << 20) + 1).encode() + b"\n", b"ERROR Invalid request\n")
+expect_closed(stalled, "the request timed out")
+oversized = connect()
+oversized.sendall(b"VALIDATE " + b"x" * 5000)
+expect_closed(oversized, "an oversized request line")
+request(connect(), b"HELLO\n", b"ERROR Unknown command\n")
+EOF
+client_status=$?
+kill -TERM "$daemon_pid"
+wait "$daemon_pid"
+daemon_status=$?
+if [ "$client_status" -ne 0 ] || [ "$daemon_status" -ne 0 ] || ! grep -q '^Request latencies:$' "$clidir/daemon.log" ; then
+  echo "[ Expected yavl-validated to serve all requests and to stop cleanly, but received: ]"
+  cat "$clidir/daemon.log"
+  exit 1
+fi
 
 echo '[ All tests finished successfully! ]'
@@ -0,0 +1,42 @@
+// Checks that --pmr types allocate all their strings from the resource they are constructed with,
+// including the items of std::array and C array fields, and that copies keep to their own resource.
+#include "spec.h"
+
+#include <memory_resource>
+#include <string>
+#include <utility>
+
+#include "check.h"
+
+const char *document = R"(
+array_var: [this string is too long for the small string buffer, b]
+nested_array_var: [[this string is too long for the small string buffer, b], [c, d]]
+c_array_var: [this string is too long for the small string buffer, b]
+nested_c_array_var: [[this string is too long for the small string buffer, b], [c, d]]
+alias_var: [this string is too long for the small string buffer, b]
+optional_var: [this string is too long for the small string buffer, b]
+vector_var: [{names: [this string is too long for the small string buffer, b]}]
+)";
+
+bool uses(const TopType &top, std::pmr::memory_resource *resource) {
+  const auto uses = [&](const std::pmr::string &value) { return value.get_allocator().resource() == resource; };
+  return uses(top.array_var[1]) && uses(top.nested_array_var[1][0]) && uses(top.c_array_var[1])
+      && uses(top.nested_c_array_var[1][0]) && uses(top.alias_var[1]) && uses((*top.optional_var)[1])
+      && uses(top.vector_var[0].names[1]);
+}
+
+int main() {
+  // Nothing may fall back to the default resource.
+  std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  std::pmr::monotonic_buffer_resource arena(std::pmr::new_delete_resource());
+  TopType top(&arena);
+  CHECK(YAVL::decode(YAML::Load(document), top, &arena));
+  CHECK(uses(top, &arena));
+  CHECK(top.nested_c_array_var[0][0] == "this string is too long for the small string buffer");
+
+  std::pmr::monotonic_buffer_resource other_arena(std::pmr::new_delete_resource());
+  TopType copy(top, &other_arena);
+  CHECK(uses(copy, &other_arena) && copy.c_array_var[0] == top.c_array_var[0]);
+  TopType moved(std::move(copy), &arena);
+  CHECK(uses(moved, &arena) && moved.nested_array_var[0][0] == top.nested_array_var[0][0]);
+}
@@ -0,0 +1,164 @@
+// Checks that values of every container, optional, enum, tuple and map type survive a round trip
+// through the binary encoding, also into objects that already hold other values, and that corrupt
+// sizes are rejected before anything is allocated for them.
+#include "spec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "check.h"
+
+bool operator==(const SubType &a, const SubType &b) {
+  return std::tie(a.size, a.names) == std::tie(b.size, b.names);
+}
+
+bool operator==(const TopType &a, const TopType &b) {
+  const auto fields = [](const TopType &value) {
+    return std::tie(value.vector_var, value.bool_vector_var, value.string_vector_var, value.array_var, value.set_var,
+        value.unordered_set_var, value.ordered_set_var, value.map_var, value.unordered_map_var, value.ordered_map_var,
+        value.optional_var, value.enum_var, value.tuple_var, value.sub_var);
+  };
+  return fields(a) == fields(b) && std::equal(a.c_array_var, a.c_array_var + 3, b.c_array_var);
+}
+
+// A document, followed by one with fewer items, one with more items and one with other keys.
+const std::vector<std::string> documents = {
+    R"(
+vector_var: [1, 2, 3]
+bool_vector_var: [true, false, true]
+string_vector_var: [a, bb, a string that is longer than the small string buffer]
+array_var: [x, y]
+c_array_var: [0.5, -1, 1e300]
+set_var: [a, b, c]
+unordered_set_var: [1, 2, 3]
+ordered_set_var: [c, b, a]
+map_var: {a: {size: small, names: [x]}, b: {size: large, names: []}}
+unordered_map_var: {1: one, 2: two}
+ordered_map_var: {b: [1], a: [2, 3]}
+optional_var: {size: large, names: [y, z]}
+enum_var: large
+tuple_var: [-7, seven, true]
+sub_var: {size: small, names: [w]}
+)",
+    R"(
+vector_var: []
+bool_vector_var: []
+string_vector_var: []
+array_var: ['', '']
+c_array_var: [0, 0, 0]
+set_var: []
+unordered_set_var: []
+ordered_set_var: []
+map_var: {}
+unordered_map_var: {}
+ordered_map_var: {}
+enum_var: small
+tuple_var: [0, '', false]
+sub_var: {size: large, names: []}
+)",
+    R"(
+vector_var: [1, 2, 3, 4, 5]
+bool_vector_var: [true, false, true, false, false]
+string_vector_var: [a, bb, a string that is longer than the small string buffer, d, e]
+array_var: [x, y]
+c_array_var: [0.5, -1, 1e300]
+set_var: [a, b, c, d, e]
+unordered_set_var: [1, 2, 3, 4, 5]
+ordered_set_var: [c, b, a, d, e]
+map_var: {a: {size: small, names: [x]}, b: {size: large, names: []}, c: {size: small, names: [u, v]}}
+unordered_map_var: {1: one, 2: two, 3: three}
+ordered_map_var: {b: [1], a: [2, 3], c: [4, 5, 6]}
+optional_var: {size: small, names: []}
+enum_var: large
+tuple_var: [7, seven, false]
+sub_var: {size: small, names: [w, w]}
+)",
+    R"(
+vector_var: [9]
+bool_vector_var: [false]
+string_vector_var: [z]
+array_var: [y, x]
+c_array_var: [3, 2, 1]
+set_var: [x, y]
+unordered_set_var: [7, 8]
+ordered_set_var: [a, x]
+map_var: {x: {size: large, names: [a, b]}, b: {size: small, names: [c]}}
+unordered_map_var: {7: seven, 2: deux}
+ordered_map_var: {x: [], b: [4, 5]}
+enum_var: small
+tuple_var: [1, one, true]
+sub_var: {size: large, names: [a, b, c]}
+)",
+};
+
+template<typename T>
+YAVL::Status decode(const YAVL::Buffer &buffer, T &obj) {
+  return YAVL::decode(std::span<const std::byte>(buffer), obj);
+}
+
+// Encodes an empty `T`, whose only field is a container, with `size` as the size of that container.
+template<typename T>
+YAVL::Buffer with_size(std::uint64_t size) {
+  YAVL::Buffer buffer;
+  YAVL::encode(T(), buffer);
+  CHECK(buffer.size() == 24);
+  std::memcpy(buffer.data() + 16, &size, sizeof(size));
+  return buffer;
+}
+
+template<typename T>
+void check_corrupt_sizes() {
+  T obj;
+  for (const std::uint64_t size : {std::uint64_t(1), std::uint64_t(1) << 40, std::numeric_limits<std::uint64_t>::max()}) {
+    CHECK(decode(with_size<T>(size), obj).message() == "Unexpected end of binary data");
+  }
+}
+
+int main() {
+  std::vector<YAVL::Buffer> buffers;
+  for (const auto &document : documents) {
+    TopType value;
+    CHECK(YAVL::decode(YAML::Load(document), value));
+    YAVL::encode(value, buffers.emplace_back());
+    TopType copy;
+    CHECK(decode(buffers.back(), copy));
+    CHECK(copy == value);
+  }
+  for (const auto &first : buffers) {
+    for (const auto &second : buffers) {
+      TopType expected;
+      CHECK(decode(second, expected));
+      TopType recycled;
+      CHECK(decode(first, recycled));
+      CHECK(decode(second, recycled));
+      CHECK(recycled == expected);
+    }
+  }
+
+  // Items that take no bytes are still bounded by the remaining input.
+  check_corrupt_sizes<EmptyTuples>();
+  check_corrupt_sizes<Strings>();
+  check_corrupt_sizes<StringSet>();
+  check_corrupt_sizes<StringMap>();
+  EmptyTuples empty_tuples;
+  CHECK(decode(with_size<EmptyTuples>(0), empty_tuples));
+  CHECK(empty_tuples.items.empty());
+
+  // Duplicates are reported, also when the nodes of the previous items are reused.
+  StringSet strings;
+  YAVL::Buffer duplicate;
+  StringSet pair;
+  pair.items = {"a", "b"};
+  YAVL::encode(pair, duplicate);
+  CHECK(decode(duplicate, strings));
+  CHECK(strings.items.size() == 2);
+  const std::string name = "b";
+  std::memcpy(duplicate.data() + 16 + 8 + 8, name.data(), 1);
+  CHECK(decode(duplicate, strings).error() == YAVL::Status::Error::duplicate_set_item);
+}
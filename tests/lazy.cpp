@@ -0,0 +1,90 @@
+// Checks that lazy fields are only decoded on first access, unless they are decoded eagerly, and
+// that they keep their value and allocator when a document is decoded into them again.
+#include "spec.h"
+
+#include <memory_resource>
+#include <sstream>
+#include <string>
+
+#include "check.h"
+
+const char *valid = R"(
+name: foo
+regions: {eu: {limit: 1, note: this note is too long for the small string buffer}, us: {limit: 2}}
+numbers: [1, 2, 3]
+)";
+const char *invalid = R"(
+name: foo
+regions: {eu: {limit: x}}
+numbers: [1, x]
+)";
+
+// Whether accessing the value of `field` fails.
+template<typename T>
+bool fails_on_access(YAVL::lazy<T> &field) {
+  try {
+    *field;
+  } catch (const YAML::Exception &) {
+    return true;
+  }
+  return false;
+}
+
+// In --pmr mode, lazy values allocate from the resource of the object that contains them, also when
+// they are decoded after the document.
+template<typename T>
+void check_resource() {
+  if constexpr (YAVL::pmr_type<T>) {
+    std::pmr::monotonic_buffer_resource arena;
+    T top(&arena);
+    CHECK(YAVL::decode(YAML::Load(valid), top, &arena));
+    CHECK(top.regions->get_allocator().resource() == &arena);
+    CHECK(top.regions->at("eu").note->get_allocator().resource() == &arena);
+    CHECK(top.numbers->get_allocator().resource() == &arena);
+    T copy(top, &arena);
+    CHECK(copy.regions->get_allocator().resource() == &arena && copy.regions->size() == 2);
+  }
+}
+
+int main() {
+  // Errors are only reported on first access, from a node and from parser events alike.
+  TopType top;
+  CHECK(YAVL::decode(YAML::Load(invalid), top));
+  CHECK(top.name == "foo");
+  CHECK(!top.regions.is_loaded() && !top.numbers.is_loaded());
+  CHECK(top.numbers.load().error() == YAVL::Status::Error::bad_conversion);
+  CHECK(top.numbers.is_loaded() && !top.regions.is_loaded());
+  CHECK(fails_on_access(top.numbers) && fails_on_access(top.regions));
+  std::istringstream input(invalid);
+  TopType from_stream;
+  YAVL::decode_stream(input, from_stream);
+  CHECK(!from_stream.numbers.is_loaded());
+  CHECK(fails_on_access(from_stream.numbers) && fails_on_access(from_stream.regions));
+
+  // They are reported right away when decoding eagerly, e.g. by `validate`.
+  CHECK(!validate<TopType>(YAML::Load(invalid)).ok);
+  CHECK(validate<TopType>(YAML::Load(valid)).ok);
+  CHECK(!YAVL::decode_eagerly);
+  {
+    const YAVL::EagerScope eager(true);
+    CHECK(YAVL::decode(YAML::Load(invalid), top).error() == YAVL::Status::Error::bad_conversion);
+    CHECK(YAVL::decode(YAML::Load(valid), top));
+    CHECK(top.regions.is_loaded() && top.numbers.is_loaded());
+  }
+  CHECK(!YAVL::decode_eagerly);
+
+  // Decoding again replaces the value on the next access, which is decoded into the same object.
+  CHECK(YAVL::decode(YAML::Load(valid), top));
+  const auto *regions = &*top.regions;
+  CHECK(top.regions->size() == 2 && top.regions->at("us").limit == 2 && !top.regions->at("us").note);
+  CHECK(YAVL::decode(YAML::Load(valid), top));
+  CHECK(!top.regions.is_loaded());
+  CHECK(&*top.regions == regions && top.regions->size() == 2 && top.regions->at("eu").limit == 1);
+  CHECK(YAVL::decode(YAML::Load(invalid), top));
+  CHECK(!top.regions.is_loaded() && fails_on_access(top.regions));
+  CHECK(YAVL::decode(YAML::Load(valid), top));
+  CHECK(top.regions->size() == 2 && top.regions->at("eu").note);
+  CHECK((*top.numbers == std::remove_cvref_t<decltype(*top.numbers)>{1, 2, 3}));
+
+  check_resource<TopType>();
+}
@@ -0,0 +1,81 @@
+// Decodes only some fields of a map type and checks that the other ones are left untouched, and
+// that the keys of the map are still checked.
+#include "spec.h"
+
+#include "check.h"
+
+using fields = YAVL::fields<TopType>;
+using YAVL::SkippedFields;
+using Error = YAVL::Status::Error;
+
+// A value that differs from everything in the documents below.
+TopType sentinel() {
+  TopType top;
+  top.my_int = -1;
+  top.my_str = "untouched";
+  top.my_vec = {-1};
+  top.my_sub.sub_int = -1;
+  top.my_opt = -1;
+  return top;
+}
+
+YAVL::Status decode(const char *document, TopType &top, const YAVL::FieldMask<TopType> &mask,
+    SkippedFields skipped = SkippedFields::skip) {
+  return YAVL::decode(YAML::Load(document), top, mask, skipped);
+}
+
+int main() {
+  const char *complete = "{my_int: 1, my_str: foo, my_vec: [1, 2], my_sub: {sub_int: 1}, my_opt: 1}";
+
+  // Skipped fields are left untouched, no matter whether they are validated.
+  for (const SkippedFields skipped : {SkippedFields::skip, SkippedFields::validate}) {
+    TopType top = sentinel();
+    CHECK(decode(complete, top, fields::my_int | fields::my_vec, skipped));
+    CHECK(top.my_int == 1);
+    CHECK((top.my_vec == std::vector<int>{1, 2}));
+    CHECK(top.my_str == "untouched");
+    CHECK(top.my_sub.sub_int == -1);
+    CHECK(top.my_opt == -1);
+  }
+
+  // A requested optional field that is missing is reset, a skipped one is left untouched.
+  TopType top = sentinel();
+  CHECK(decode("{my_int: 1, my_str: foo, my_vec: [], my_sub: {sub_int: 1}}", top, fields::my_opt));
+  CHECK(!top.my_opt);
+  top = sentinel();
+  CHECK(decode("{my_int: 1, my_str: foo, my_vec: [], my_sub: {sub_int: 1}}", top, fields::my_int));
+  CHECK(top.my_opt == -1);
+
+  // Skipped fields may be missing or invalid only if they are skipped instead of validated.
+  for (const char *document : {"{my_int: 1}", "{my_int: 1, my_str: [foo], my_vec: foo, my_sub: {}}"}) {
+    top = sentinel();
+    CHECK(decode(document, top, fields::my_int));
+    CHECK(top.my_int == 1);
+    CHECK(top.my_str == "untouched");
+  }
+  top = sentinel();
+  YAVL::Status status = decode("{my_int: 1}", top, fields::my_int, SkippedFields::validate);
+  CHECK(status.error() == Error::missing_key && status.key() == 1);
+  status = decode("{my_int: 1, my_str: [foo], my_vec: [], my_sub: {sub_int: 1}}", top, fields::my_int,
+      SkippedFields::validate);
+  CHECK(status.error() == Error::bad_conversion);
+  status = decode("{my_int: 1, my_str: foo, my_vec: [], my_sub: {}}", top, fields::my_int, SkippedFields::validate);
+  CHECK(status.error() == Error::missing_key && status.key() == 0);
+
+  // Requested fields have to be present in either case.
+  for (const SkippedFields skipped : {SkippedFields::skip, SkippedFields::validate}) {
+    status = decode("{my_str: foo, my_vec: [], my_sub: {sub_int: 1}}", top, fields::my_int, skipped);
+    CHECK(status.error() == Error::missing_key && status.key() == 0);
+  }
+
+  // Superfluous and duplicate keys are reported, even among the skipped fields.
+  for (const SkippedFields skipped : {SkippedFields::skip, SkippedFields::validate}) {
+    status = decode("{my_int: 1, my_str: foo, my_vec: [], my_sub: {sub_int: 1}, extra: 1}", top, fields::my_int,
+        skipped);
+    CHECK(status.error() == Error::superfluous_key);
+    status = decode("{my_int: 1, extra: 1}", top, fields::my_int, skipped);
+    CHECK(status.error() == (skipped == SkippedFields::skip ? Error::superfluous_key : Error::missing_key));
+    status = decode("{my_int: 1, my_str: foo, my_str: bar}", top, fields::my_int, skipped);
+    CHECK(status.error() == Error::duplicate_map_item);
+  }
+}
@@ -0,0 +1,111 @@
+// Decodes documents of different shapes into the same object one after another and checks that
+// each decode gives the same value as decoding the document into a new object, also when they are
+// decoded from their binary encoding.
+#include "spec.h"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "check.h"
+
+bool operator==(const TopType &a, const TopType &b) {
+  const auto fields = [](const TopType &value) {
+    return std::tie(value.map_var, value.int_map_var, value.unordered_map_var, value.set_var, value.vector_set_var,
+        value.unordered_set_var, value.ordered_map_var, value.int_ordered_map_var, value.ordered_set_var,
+        value.int_ordered_set_var);
+  };
+  return fields(a) == fields(b);
+}
+
+// The first document, followed by the same one with fewer and with more items, with the items in
+// reverse order and with other keys.
+const std::vector<std::string> documents = {
+    R"(
+map_var: {a: [x, y], b: [z], c: []}
+int_map_var: {1: one, 2: two, 3: three}
+unordered_map_var: {a: x, b: y, c: z}
+set_var: [a, b, c]
+vector_set_var: [[1, 2], [3], []]
+unordered_set_var: [a, b, c]
+ordered_map_var: {a: [1, 2], b: [3], c: []}
+int_ordered_map_var: {1: one, 2: two, 3: three}
+ordered_set_var: [a, b, c]
+int_ordered_set_var: [1, 2, 3]
+)",
+    R"(
+map_var: {b: [z]}
+int_map_var: {2: two}
+unordered_map_var: {b: y}
+set_var: [b]
+vector_set_var: [[3]]
+unordered_set_var: [b]
+ordered_map_var: {b: [3]}
+int_ordered_map_var: {2: two}
+ordered_set_var: [b]
+int_ordered_set_var: [2]
+)",
+    R"(
+map_var: {a: [x, y], b: [z], c: [], d: [w, w, w], e: [v]}
+int_map_var: {1: one, 2: two, 3: three, 4: four, 5: five}
+unordered_map_var: {a: x, b: y, c: z, d: w, e: v}
+set_var: [a, b, c, d, e]
+vector_set_var: [[1, 2], [3], [], [4, 4, 4], [5]]
+unordered_set_var: [a, b, c, d, e]
+ordered_map_var: {a: [1, 2], b: [3], c: [], d: [4, 4, 4], e: [5]}
+int_ordered_map_var: {1: one, 2: two, 3: three, 4: four, 5: five}
+ordered_set_var: [a, b, c, d, e]
+int_ordered_set_var: [1, 2, 3, 4, 5]
+)",
+    R"(
+map_var: {c: [], b: [z], a: [x, y]}
+int_map_var: {3: three, 2: two, 1: one}
+unordered_map_var: {c: z, b: y, a: x}
+set_var: [c, b, a]
+vector_set_var: [[], [3], [1, 2]]
+unordered_set_var: [c, b, a]
+ordered_map_var: {c: [], b: [3], a: [1, 2]}
+int_ordered_map_var: {3: three, 2: two, 1: one}
+ordered_set_var: [c, b, a]
+int_ordered_set_var: [3, 2, 1]
+)",
+    R"(
+map_var: {b: [x, y], x: [z], y: [a, b, c]}
+int_map_var: {2: one, 7: two, 8: three}
+unordered_map_var: {b: x, x: y, y: z}
+set_var: [b, x, y]
+vector_set_var: [[1], [3, 2], [0]]
+unordered_set_var: [b, x, y]
+ordered_map_var: {b: [1, 2], x: [3], y: []}
+int_ordered_map_var: {2: one, 7: two, 8: three}
+ordered_set_var: [b, x, y]
+int_ordered_set_var: [2, 7, 8]
+)",
+};
+
+int main() {
+  for (const auto &first : documents) {
+    for (const auto &second : documents) {
+      TopType expected;
+      CHECK(YAVL::decode(YAML::Load(second), expected));
+      TopType recycled;
+      CHECK(YAVL::decode(YAML::Load(first), recycled));
+      CHECK(YAVL::decode(YAML::Load(second), recycled));
+      CHECK(recycled == expected);
+
+      YAVL::Buffer buffer;
+      YAVL::encode(expected, buffer);
+      CHECK(YAVL::decode(YAML::Load(first), recycled));
+      CHECK(YAVL::decode(std::span<const std::byte>(buffer), recycled));
+      CHECK(recycled == expected);
+    }
+  }
+  // Keys that are decoded while matching the previous items still report their errors.
+  TopType recycled;
+  CHECK(YAVL::decode(YAML::Load(documents[0]), recycled));
+  CHECK(YAVL::decode(YAML::Load("int_map_var: {1: one, x: two}"), recycled).error() == YAVL::Status::Error::bad_conversion);
+  CHECK(YAVL::decode(YAML::Load(documents[0]), recycled));
+  CHECK(YAVL::decode(YAML::Load("int_map_var: {1: one, 1: two}"), recycled).error() == YAVL::Status::Error::duplicate_map_item);
+}
@@ -0,0 +1,106 @@
+// Decodes the correct sample of an example in every mode and checks that all of them produce the
+// same value as decoding the YAML::Node, including a round trip through the binary encoding.
+#include "spec.h"
+
+#include <cstddef>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+// Compares the YAML written for two values, ignoring the flow or block style that YAML::Node
+// members keep from the document. Unless `ordered` is set, the items of sequences and mappings may
+// be in any order.
+bool same_yaml(const YAML::Node &a, const YAML::Node &b, bool ordered = true) {
+  if (a.Type() != b.Type() || a.size() != b.size()) {
+    return false;
+  }
+  if (a.IsScalar()) {
+    return a.Scalar() == b.Scalar();
+  }
+  const auto same_item = [&](const auto &it, const auto &jt) {
+    return a.IsSequence() ? same_yaml(*it, *jt, ordered)
+                          : same_yaml(it->first, jt->first, ordered) && same_yaml(it->second, jt->second, ordered);
+  };
+  if (ordered) {
+    for (auto it = a.begin(), jt = b.begin(); it != a.end(); ++it, ++jt) {
+      if (!same_item(it, jt)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  std::vector<bool> used(b.size());
+  for (auto it = a.begin(); it != a.end(); ++it) {
+    std::size_t index = 0;
+    auto jt = b.begin();
+    while (jt != b.end() && (used[index] || !same_item(it, jt))) {
+      ++jt;
+      ++index;
+    }
+    if (jt == b.end()) {
+      return false;
+    }
+    used[index] = true;
+  }
+  return true;
+}
+
+template<typename T>
+YAML::Node emit(const T &value) {
+  YAML::Emitter output;
+  output << value;
+  return YAML::Load(output.c_str());
+}
+
+// Checks that the binary encoding of `value` decodes to the same value, also into an object that
+// already holds it, and that damaged encodings are rejected. Unordered containers are encoded in
+// their iteration order, which can change when their items are inserted again.
+template<typename T>
+void check_binary(const T &value, const YAML::Node &expected) {
+  if constexpr (YAVL::binary_schema_type<T>) {
+    YAVL::Buffer buffer;
+    YAVL::encode(value, buffer);
+    T copy;
+    CHECK(YAVL::decode(std::span<const std::byte>(buffer), copy));
+    CHECK(same_yaml(emit(copy), expected, false));
+    CHECK(YAVL::decode(std::span<const std::byte>(buffer), copy));
+    CHECK(same_yaml(emit(copy), expected, false));
+
+    // The magic, the format version and the schema hash.
+    for (const std::size_t offset : {0, 4, 8}) {
+      YAVL::Buffer damaged = buffer;
+      damaged[offset] ^= std::byte(1);
+      T obj;
+      const YAVL::Status status = YAVL::decode(std::span<const std::byte>(damaged), obj);
+      CHECK(status.message()
+          == (offset == 0 ? "Not a binary encoding of yavl-cpp"
+                          : "The binary encoding was made from a different schema of the type"));
+    }
+    for (std::size_t size = 4; size < buffer.size(); ++size) {
+      T obj;
+      const YAVL::Status status = YAVL::decode(std::span<const std::byte>(buffer).first(size), obj);
+      CHECK(status.message() == "Unexpected end of binary data");
+    }
+    buffer.push_back(std::byte(0));
+    T obj;
+    const YAVL::Status status = YAVL::decode(std::span<const std::byte>(buffer), obj);
+    CHECK(status.message() == "Unexpected data after the end of the binary encoding");
+  }
+}
+
+int main(int, char **argv) {
+  const YAML::Node node = YAML::LoadFile(argv[1]);
+  TopType from_node;
+  CHECK(YAVL::decode(node, from_node));
+  const YAML::Node expected = emit(from_node);
+
+  std::ifstream input(argv[1]);
+  TopType from_stream;
+  YAVL::decode_stream(input, from_stream);
+  CHECK(same_yaml(emit(from_stream), expected));
+
+  check_binary(from_node, expected);
+}
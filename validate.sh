@@ -5,6 +5,31 @@ set -euo pipefail
 sample_file="$1"
 spec_file="$2"
 type_name="$3"
+shift 3
+
+basedir="$(dirname "$0")"
+incdir="$basedir"/include
+libtemplate="$basedir"/src/libtemplate.cpp
+cxx=g++
+cxxflags=(-std=c++20 -shared -fPIC)
+# The library links yaml-cpp itself, so that it can be loaded by programs that don't use yaml-cpp.
+IFS=' ' read -r -a ldflags <<< "$(pkg-config --libs yaml-cpp)"
+
+# --pmr is an option of yavl-compile, all other options are passed on to yavl-validate-sample.
+compile_flags=()
+validate_flags=()
+for arg in "$@" ; do
+    if [ "$arg" = '--pmr' ] ; then
+        compile_flags+=(--pmr)
+    else
+        validate_flags+=("$arg")
+    fi
+done
+
+# Compiled libraries are cached by a hash of everything that goes into them. Set YAVL_CACHE_SIZE to
+# change the number of libraries that are kept, or YAVL_CACHE_DIR=/dev/null to disable the cache.
+cachedir="${YAVL_CACHE_DIR:-${XDG_CACHE_HOME:-$HOME/.cache}/yavl-cpp}"
+cachesize="${YAVL_CACHE_SIZE:-32}"
 
 tmpdir="$(mktemp -d)"
 
@@ -14,15 +39,69 @@ function cleanup() {
 
 trap cleanup EXIT
 
-incdir="$(dirname "$0")"/include
-libtemplate="$(dirname "$0")"'/src/libtemplate.cpp'
-shared_object="$tmpdir"/libspec.so
+# Prints the files that the spec pulls into the library besides the headers of yavl-cpp: the module
+# of its custom code generator, and the headers of its quoted extra includes, which the compiler
+# finds in the include directory.
+function spec_inputs() {
+    python3 - "$spec_file" "$incdir" <<'EOF'
+import os
+import sys
+
+import yaml
+
+spec_file, incdir = sys.argv[1:]
+spec = yaml.safe_load(open(spec_file))
+if isinstance(spec, dict):
+    if "CustomCodeGenerator" in spec:
+        print(os.path.join(os.path.dirname(os.path.realpath(spec_file)), spec["CustomCodeGenerator"][0]))
+    for header in spec.get("ExtraIncludes", []):
+        if header.startswith('"') and os.path.isfile(os.path.join(incdir, header.strip('"'))):
+            print(os.path.join(incdir, header.strip('"')))
+EOF
+}
+
+function cache_key() {
+    local inputs
+    mapfile -t inputs < <(spec_inputs)
+    {
+        sha256sum < "$spec_file"
+        cat "$basedir"/yavl-compile "$basedir"/src/*.py "$libtemplate" "$incdir"/yavl-cpp/*.h "$incdir"/tsl/*.h \
+            "${inputs[@]}" | sha256sum
+        "$cxx" --version
+        pkg-config --modversion yaml-cpp
+        echo "${cxxflags[@]}" "${ldflags[@]}" "${compile_flags[@]}"
+    } | sha256sum | cut -d ' ' -f 1
+}
 
-echo 'Compiling spec...'
-"$(dirname "$0")"/yavl-compile "$spec_file" "$tmpdir"/spec.h
+function compile() {
+    echo 'Compiling spec...'
+    "$basedir"/yavl-compile "${compile_flags[@]}" "$spec_file" "$tmpdir"/spec.h
 
-echo 'Compiling shared object...'
-g++ -std=c++20 -shared -fPIC "$libtemplate" -I"$tmpdir" -I"$incdir" -o "$shared_object" 
+    echo 'Compiling shared object...'
+    "$cxx" "${cxxflags[@]}" "$libtemplate" -I"$tmpdir" -I"$incdir" "${ldflags[@]}" -o "$1"
+}
+
+shared_object="$tmpdir"/libspec.so
+if [[ " $* " == *" --interpret "* ]] ; then
+    # The spec is loaded by yavl-validate-sample itself, nothing to compile.
+    shared_object="$spec_file"
+elif mkdir -p "$cachedir" 2>/dev/null && [ -w "$cachedir" ] ; then
+    cached_object="$cachedir/$(cache_key).so"
+    if [ -f "$cached_object" ] ; then
+        echo 'Using cached shared object...'
+        touch "$cached_object"
+    else
+        # Build next to the cache entry and rename it, so that concurrent runs never load a partial library.
+        compile "$tmpdir"/libspec.so
+        cp "$tmpdir"/libspec.so "$cached_object.$$.tmp"
+        mv -f "$cached_object.$$.tmp" "$cached_object"
+        # Evict the least recently used libraries.
+        ls -t "$cachedir"/*.so | tail -n +"$(( cachesize + 1 ))" | xargs -r rm -f
+    fi
+    shared_object="$cached_object"
+else
+    compile "$shared_object"
+fi
 
 echo 'Validating...'
-"$(dirname "$0")"/yavl-validate-sample "$sample_file" "$shared_object" "$type_name"
+"$basedir"/yavl-validate-sample "${validate_flags[@]}" "$sample_file" "$shared_object" "$type_name"